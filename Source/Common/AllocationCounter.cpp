@@ -0,0 +1,95 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//  AllocationCounter.cpp
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "AllocationCounter.h"
+
+#include <new>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifdef DEBUG
+
+static thread_local uint64_t s_nAllocations = 0;
+static thread_local unsigned s_nPauses      = 0;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void * operator new( size_t size )
+{
+    if (s_nPauses == 0)
+        ++s_nAllocations;
+
+    if (size == 0)
+        size = 1;
+
+    for (;;)
+    {
+        void * p = malloc( size );
+        if (p)
+            return p;
+
+        std::new_handler handler = std::get_new_handler();
+        if (!handler)
+            throw std::bad_alloc();
+        handler();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void * operator new( size_t size, const std::nothrow_t & ) noexcept
+{
+    try
+    {
+        return operator new( size );
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void * operator new[]( size_t size )                            { return operator new( size ); }
+void * operator new[]( size_t size, const std::nothrow_t & tag ) noexcept   { return operator new( size, tag ); }
+
+void operator delete(   void * p ) noexcept                             { free( p ); }
+void operator delete[]( void * p ) noexcept                             { free( p ); }
+void operator delete(   void * p, const std::nothrow_t & ) noexcept     { free( p ); }
+void operator delete[]( void * p, const std::nothrow_t & ) noexcept     { free( p ); }
+
+#endif // DEBUG
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool AllocationCounting() throw()
+{
+#ifdef DEBUG
+    return true;
+#else
+    return false;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+uint64_t AllocationCount() throw()
+{
+#ifdef DEBUG
+    return s_nAllocations;
+#else
+    return 0;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+AllocationCountPause::AllocationCountPause() throw()
+{
+#ifdef DEBUG
+    ++s_nPauses;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+AllocationCountPause::~AllocationCountPause() throw()
+{
+#ifdef DEBUG
+    --s_nPauses;
+#endif
+}
@@ -0,0 +1,35 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//  AllocationCounter.h
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include "common.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Debug builds (DEBUG defined, e.g. make debug) replace the global operator new to count the heap
+// allocations of each thread, to check that the event loop no longer allocates once it is warmed up.
+// Release builds keep the standard operator new and the count stays 0.
+
+bool     AllocationCounting() throw();      // true if allocations are counted in this build
+uint64_t AllocationCount()    throw();      // allocations made by the calling thread
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Leaves the allocations of the calling thread uncounted while in scope, for code whose allocations
+// are not the caller's to avoid, such as Sherpa's matrix element calculation.
+
+class AllocationCountPause
+{
+public:
+    AllocationCountPause()  throw();
+    ~AllocationCountPause() throw();
+
+private:
+    AllocationCountPause(const AllocationCountPause &)              = delete;   // disable copy constructor
+    AllocationCountPause & operator=(const AllocationCountPause &)  = delete;   // disable assignment operator
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // ALLOCATION_COUNTER_H
@@ -0,0 +1,100 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//  ColorClasses.cpp
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "ColorClasses.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Colour assignments of ncolinds colour indices with as many of each colour among the colour
+// indices (first half) as among the anti-colour indices (second half). The anti-colours of each
+// colour assignment are generated directly as the distinct permutations of its colours.
+// The combinations are ordered as by the base-3 code of the former exhaustive scan.
+std::vector<std::vector<int> > BalancedColorCombinations(size_t ncolinds)
+{
+    std::vector<std::vector<int> > combinations;
+
+    const size_t half = ncolinds/2;
+    std::vector<int> colors(half, 1);
+    std::vector<int> combination(ncolinds);
+
+    for (;;)
+    {
+        std::vector<int> anticolors(colors);
+        std::sort(anticolors.begin(), anticolors.end());
+        do
+        {
+            std::copy(colors.begin(), colors.end(), combination.begin());
+            std::copy(anticolors.begin(), anticolors.end(), combination.begin() + half);
+            combinations.push_back(combination);
+        }
+        while (std::next_permutation(anticolors.begin(), anticolors.end()));
+
+        // next colour assignment, first index fastest
+        size_t m(0);
+        for ( ; m<half; m++)
+        {
+            if (colors[m]<3) { colors[m]+=1; break; }
+            colors[m] = 1;
+        }
+        if (m==half) break;
+    }
+
+    // base-3 code order: compare from the last index
+    std::sort(combinations.begin(), combinations.end(),
+              [](const std::vector<int> &a, const std::vector<int> &b)
+              { return std::lexicographical_compare(a.rbegin(), a.rend(), b.rbegin(), b.rend()); });
+
+    return combinations;
+}
+
+// The colour-summed matrix element only depends on which colour indices are equal, so combinations
+// related by a global relabelling of r, g, b give the same Differential(). Each class is represented
+// by its member with the colours numbered in order of first appearance, and weighted by its size
+// (1, 3 or 6). The classes only depend on ncolinds and are shared by all calculators.
+ColorClassesPtr ColorClasses(size_t ncolinds)
+{
+    static std::mutex                           s_mutex;
+    static std::map<size_t, ColorClassesPtr>    s_classes;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+
+    ColorClassesPtr &cached = s_classes[ncolinds];
+    if (cached)
+        return cached;
+
+    std::shared_ptr<ColorClassList> classes(new ColorClassList);
+    std::map<std::vector<int>, size_t> classIndex;
+
+    std::vector<std::vector<int> > combinations(BalancedColorCombinations(ncolinds));
+    for (size_t c(0); c<combinations.size(); c++)
+    {
+        // relabel the colours in order of first appearance
+        int relabel[4] = { 0, 0, 0, 0 };
+        int next(1);
+        std::vector<int> canonical(combinations[c]);
+        for (size_t m(0); m<canonical.size(); m++)
+        {
+            int &label = relabel[canonical[m]];
+            if (!label) label = next++;
+            canonical[m] = label;
+        }
+
+        std::map<std::vector<int>, size_t>::const_iterator fit = classIndex.find(canonical);
+        if (fit == classIndex.end())
+        {
+            classIndex[canonical] = classes->combinations.size();
+            classes->combinations.push_back(canonical);
+            classes->multiplicities.push_back(1.);
+        }
+        else
+            classes->multiplicities[fit->second] += 1.;
+    }
+
+    cached = classes;
+    return cached;
+}
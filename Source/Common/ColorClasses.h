@@ -0,0 +1,30 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//  ColorClasses.h
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef COLORCLASSES_H
+#define COLORCLASSES_H
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Colour combinations summed by SherpaMECalculator::CSMatrixElement. Colours are 1, 2 and 3; the
+// first half of a combination holds the colour indices, the second half the anti-colour indices.
+
+struct ColorClassList
+{
+    std::vector<std::vector<int> >  combinations;       // one representative per colour relabelling class
+    std::vector<double>             multiplicities;     // number of colour combinations in the class
+};
+
+typedef std::shared_ptr<const ColorClassList>   ColorClassesPtr;
+
+std::vector<std::vector<int> > BalancedColorCombinations(size_t ncolinds);
+
+ColorClassesPtr ColorClasses(size_t ncolinds);  // cached per ncolinds, thread safe
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // COLORCLASSES_H
@@ -25,6 +25,73 @@ struct EventFileVertex
     std::vector<Particle>   output;
 };
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// hash of the flavours and momenta of a vertex; identical kinematics give identical hashes
+
+inline uint64_t HashVertex( const EventFileVertex & vertex ) throw()
+{
+    uint64_t hash = HashValue( vertex.input.size() );
+
+    for (const std::vector<EventFileVertex::Particle> * pParticles : { &vertex.input, &vertex.output })
+    {
+        for (const EventFileVertex::Particle & part : *pParticles)
+        {
+            hash = HashValue( part.pdg, hash );
+            hash = HashValue( part.E,   hash );
+            hash = HashValue( part.px,  hash );
+            hash = HashValue( part.py,  hash );
+            hash = HashValue( part.pz,  hash );
+        }
+    }
+
+    return hash;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// second hash of the flavours and momenta of a vertex, computed independently of HashVertex;
+// stores that do not keep the vertex itself check it to tell a HashVertex collision from a match
+
+inline uint64_t CheckHashVertex( const EventFileVertex & vertex ) throw()
+{
+    const uint64_t step = 0x9E3779B97F4A7C15ULL;
+
+    uint64_t hash = HashMix64( vertex.output.size() + step );
+
+    for (const std::vector<EventFileVertex::Particle> * pParticles : { &vertex.input, &vertex.output })
+    {
+        for (const EventFileVertex::Particle & part : *pParticles)
+        {
+            for (double value : { part.E, part.px, part.py, part.pz })
+            {
+                uint64_t bits = 0;
+                memcpy( &bits, &value, sizeof(bits) );
+                hash = HashMix64( hash ^ bits ) + step;
+            }
+
+            hash = HashMix64( hash ^ static_cast<uint64_t>(static_cast<int64_t>(part.pdg)) ) + step;
+        }
+    }
+
+    return hash;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// true if two vertices have the same flavours and momenta; confirms a match of their hashes
+
+inline bool SameKinematics( const EventFileVertex & a, const EventFileVertex & b ) throw()
+{
+    auto sameParticles = []( const std::vector<EventFileVertex::Particle> & pa, const std::vector<EventFileVertex::Particle> & pb )
+    {
+        return (pa.size() == pb.size()) &&
+               std::equal( pa.begin(), pa.end(), pb.begin(), []( const EventFileVertex::Particle & x, const EventFileVertex::Particle & y )
+               {
+                   return (x.pdg == y.pdg) && (x.E == y.E) && (x.px == y.px) && (x.py == y.py) && (x.pz == y.pz);
+               } );
+    };
+
+    return sameParticles( a.input, b.input ) && sameParticles( a.output, b.output );
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 struct EventFileEvent
@@ -41,7 +108,9 @@ public:
 
     virtual void GetSignalVertex( EventFileVertex & vertex ) const      = 0;
 
-    virtual void SetCoefficients( const DoubleVector & coefs )          = 0;
+    virtual void SetCoefficients( const double * pCoefs, size_t nCoefs ) = 0;    // copied into storage kept by the event
+
+    void SetCoefficients( const DoubleVector & coefs )                  { SetCoefficients( coefs.data(), coefs.size() ); }
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -69,6 +138,8 @@ public:
 
     virtual bool ReadEvent( EventFileEvent & event )                    = 0;  // returns false if no more events
 
+    virtual uint64_t SkipEvents( uint64_t nEvents )                     = 0;  // returns number of events skipped
+
     // writing
     virtual void SetCoefficientNames( const StringVector & coefNames )  = 0;
 
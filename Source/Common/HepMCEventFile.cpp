@@ -25,7 +25,7 @@ public:
 
     virtual void GetSignalVertex( EventFileVertex & vertex ) const override;
 
-    virtual void SetCoefficients( const DoubleVector & coefs ) override;
+    virtual void SetCoefficients( const double * pCoefs, size_t nCoefs ) override;
 
 private:
     static EventFileVertex::Particle ConvertParticle( const HepMC::GenParticle & part );
@@ -41,6 +41,16 @@ private:
 // class HepMCEventFile
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool HepMCEventFile::IsSupported( const std::string & fileName ) throw()  // static
+{
+    // HepMC text files, optionally gzip compressed, carry no fixed extension; accept all but root files
+    const std::string rootExtension( ".root" );
+
+    return (fileName.size() < rootExtension.size()) ||
+           (fileName.compare( fileName.size() - rootExtension.size(), rootExtension.size(), rootExtension ) != 0);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 HepMCEventFile::HepMCEventFile()
 {
@@ -128,6 +138,31 @@ bool HepMCEventFile::ReadEvent( EventFileEvent & vEvent )
     return true;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+uint64_t HepMCEventFile::SkipEvents( uint64_t nEvents )
+{
+    if (!m_upIO)
+        ThrowError( "SkipEvents() called on closed file." );
+
+    if (nEvents == 0)
+        return 0;
+
+    // the text format has no index, so skipped events must still be parsed
+
+    if (!m_upSkipEvent)
+        m_upSkipEvent.reset( new HepMC::GenEvent );
+
+    uint64_t nSkipped = 0;
+    for ( ; nSkipped < nEvents; ++nSkipped)
+    {
+        m_upSkipEvent->clear();
+        if (!m_upIO->fill_next_event( m_upSkipEvent.get() ))
+            break;  // no more events
+    }
+
+    return nSkipped;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 void HepMCEventFile::SetCoefficientNames( const StringVector & coefNames )
 {
@@ -196,7 +231,8 @@ void HepMCEventFileEvent::Clear()
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 void HepMCEventFileEvent::GetSignalVertex( EventFileVertex & vertex ) const
 {
-    vertex = EventFileVertex();  // clear vertex
+    vertex.input .clear();      // clear vertex, keeping the capacity for the next event
+    vertex.output.clear();
 
     if (!m_upGenEvent)
         ThrowError( "GetSignalVertex() called on uninitialized event." );
@@ -234,9 +270,9 @@ void HepMCEventFileEvent::GetSignalVertex( EventFileVertex & vertex ) const
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-void HepMCEventFileEvent::SetCoefficients( const DoubleVector & coefs )
+void HepMCEventFileEvent::SetCoefficients( const double * pCoefs, size_t nCoefs )
 {
-    m_coefs = coefs;
+    m_coefs.assign( pCoefs, pCoefs + nCoefs );  // recycled events keep their capacity
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -13,6 +13,7 @@
 
 namespace HepMC
 {
+class GenEvent;
 class IO_GenEvent;
 }
 
@@ -37,6 +38,8 @@ public:
 
     virtual bool ReadEvent( EventFileEvent & event ) override;
 
+    virtual uint64_t SkipEvents( uint64_t nEvents ) override;
+
     virtual void SetCoefficientNames( const StringVector & coefNames )  override;
 
     virtual void WriteEvent( const EventFileEvent & event ) override;
@@ -46,6 +49,7 @@ private:
     std::unique_ptr<std::istream>           m_upIStream;
     std::unique_ptr<std::ostream>           m_upOStream;
     std::unique_ptr<HepMC::IO_GenEvent>     m_upIO;
+    std::unique_ptr<HepMC::GenEvent>        m_upSkipEvent;      // parsed and discarded by SkipEvents(), kept across calls
     StringVector                            m_coefNames;
 };
 
@@ -34,16 +34,19 @@ static bool AttachBranchToVariable( TTree * pTree, const char * branchName, T &
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 template<typename T>
-static bool CreateBranchForVariable( TTree * pTree, const char * branchName, T * pVariable ) //, const char * pLeafList = nullptr )
+static bool CreateBranchForVariable( TTree * pTree, const char * branchName, T * pVariable, const char * pLeafList = nullptr )
 {
-    pTree->Branch( branchName, pVariable );
+    if (!pLeafList)
+        pTree->Branch( branchName, pVariable );                 // derive size from type T
+    else
+        pTree->Branch( branchName, pVariable, pLeafList );      // derive size from pLeafList content
     return true;
 }
 
 template<typename T>
-static bool CreateBranchForVariable( TTree * pTree, const char * branchName, T & variable )
+static bool CreateBranchForVariable( TTree * pTree, const char * branchName, T & variable, const char * pLeafList = nullptr )
 {
-    return CreateBranchForVariable(pTree, branchName, &variable );
+    return CreateBranchForVariable(pTree, branchName, &variable, pLeafList );
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -59,8 +62,32 @@ void MERootEvent::SetInputTree( TTree * pTree )
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-void MERootEvent::SetOutputTree( TTree * pTree )
+void MERootEvent::SetOutputTree( TTree * pTree, bool bError /*= false*/ )
 {
     CreateBranchForVariable( pTree, "id", id );
     CreateBranchForVariable( pTree, "me", me );
+
+    if (bError)
+        CreateBranchForVariable( pTree, "me_err", me_err );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void MEPointsRootEvent::SetInputTree( TTree * pTree )
+{
+    pTree->SetMakeClass(1);
+    
+    // disable all input branches as default
+    pTree->SetBranchStatus( "*", 0 );
+    
+    AttachBranchToVariable( pTree, "id",     id     );
+    AttachBranchToVariable( pTree, "npoint", npoint );
+    AttachBranchToVariable( pTree, "me",     me     );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void MEPointsRootEvent::SetOutputTree( TTree * pTree )
+{
+    CreateBranchForVariable( pTree, "id",     id     );
+    CreateBranchForVariable( pTree, "npoint", npoint );
+    CreateBranchForVariable( pTree, "me",     me,     "me[npoint]/D" );
 }
@@ -16,8 +16,25 @@ class TTree;
 
 struct MERootEvent
 {
-    Int_t       id   = 0;
-    Double_t    me   = 0;
+    Int_t       id      = 0;
+    Double_t    me      = 0;
+    Double_t    me_err  = 0;    // statistical error of a colour-sampled me, 0 if exact
+
+    
+    void SetInputTree(  TTree * pTree );
+    void SetOutputTree( TTree * pTree, bool bError = false );  // bError: add the me_err branch
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// matrix elements of one event at several parameter points
+
+struct MEPointsRootEvent
+{
+    static const size_t max_npoint  = 1000;
+
+    Int_t       id                  = 0;
+    Int_t       npoint              = 0;
+    Double_t    me[max_npoint]      = {};   // [npoint]
 
     
     void SetInputTree(  TTree * pTree );
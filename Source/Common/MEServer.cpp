@@ -0,0 +1,382 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//  MEServer.cpp
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "MEServer.h"
+
+#include "common.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef MSG_NOSIGNAL
+static const int SendFlags = MSG_NOSIGNAL;     // report a closed peer as EPIPE instead of SIGPIPE
+#else
+static const int SendFlags = 0;
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static sockaddr_un SocketAddress( const std::string & socketPath )
+{
+    sockaddr_un address;
+    memset( &address, 0, sizeof(address) );
+    address.sun_family = AF_UNIX;
+
+    if (socketPath.empty() || (socketPath.size() >= sizeof(address.sun_path)))
+        ThrowError( "Invalid SherpaME server socket path (" + socketPath + ")." );
+
+    strncpy( address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1 );
+    return address;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static std::string ReadLine( int fd )
+{
+    std::string line;
+
+    for (;;)
+    {
+        char    c     = 0;
+        ssize_t nRead = read( fd, &c, 1 );     // lines are short, and the data after them belongs to the caller
+        if (nRead < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            ThrowError( std::system_error( errno, std::generic_category(), "Failed to read from SherpaME server connection." ) );
+        }
+
+        if (nRead == 0)
+            ThrowError( "SherpaME server connection closed unexpectedly." );
+
+        if (c == '\n')
+            return line;
+
+        line += c;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static std::vector<std::string> SplitTabs( const std::string & line )
+{
+    std::vector<std::string> fields;
+
+    size_t start = 0;
+    for (size_t tab; (tab = line.find( '\t', start )) != std::string::npos; start = tab + 1)
+        fields.push_back( line.substr( start, tab - start ) );
+    fields.push_back( line.substr( start ) );
+
+    return fields;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static std::string RequestLine( const MEServerRequest & request )
+{
+    if (request.inputFile.find_first_of( "\t\n" ) != std::string::npos)
+        ThrowError( "SherpaME server input file name contains a tab or newline (" + request.inputFile + ")." );
+
+    std::string line = "EVAL\t" + request.inputFile;
+    for (const std::string & arg : request.sherpaArgs)
+    {
+        if (arg.find_first_of( "\t\n" ) != std::string::npos)
+            ThrowError( "SherpaME server argument contains a tab or newline (" + arg + ")." );
+        line += "\t" + arg;
+    }
+
+    return line;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static void ParseRequest( const std::string & line, MEServerRequest & request )
+{
+    request = MEServerRequest();
+
+    std::vector<std::string> fields = SplitTabs( line );
+
+    if (fields[0] == "QUIT")
+    {
+        request.bQuit = true;
+        return;
+    }
+
+    if ((fields[0] != "EVAL") || (fields.size() < 2) || fields[1].empty())
+        ThrowError( "Invalid SherpaME server request." );
+
+    request.inputFile = fields[1];
+
+    for (size_t i = 2; i < fields.size(); ++i)
+    {
+        if (!fields[i].empty())
+            request.sherpaArgs.push_back( fields[i] );
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static void ReadExact( int fd, char * pData, size_t nBytes )
+{
+    while (nBytes)
+    {
+        ssize_t nRead = read( fd, pData, nBytes );
+        if (nRead < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            ThrowError( std::system_error( errno, std::generic_category(), "Failed to read from SherpaME point process socket." ) );
+        }
+
+        if (nRead == 0)
+            ThrowError( "SherpaME point process socket closed unexpectedly." );
+
+        pData  += nRead;
+        nBytes -= static_cast<size_t>(nRead);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static int Connect( const std::string & socketPath )
+{
+    sockaddr_un address = SocketAddress( socketPath );
+
+    int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if (fd < 0)
+        ThrowError( std::system_error( errno, std::generic_category(), "Failed to create socket." ) );
+
+    if (connect( fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address) ) != 0)
+    {
+        int error = errno;
+        close( fd );
+        ThrowError( std::system_error( error, std::generic_category(), "Failed to connect to SherpaME server (" + socketPath + ")" ) );
+    }
+
+    return fd;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// server
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+int MEServerListen( const std::string & socketPath )
+{
+    sockaddr_un address = SocketAddress( socketPath );
+
+    int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if (fd < 0)
+        ThrowError( std::system_error( errno, std::generic_category(), "Failed to create socket." ) );
+
+    unlink( socketPath.c_str() );   // left behind by a previous server
+
+    if ((bind( fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address) ) != 0) || (listen( fd, 16 ) != 0))
+    {
+        int error = errno;
+        close( fd );
+        ThrowError( std::system_error( error, std::generic_category(), "Failed to listen on socket (" + socketPath + ")" ) );
+    }
+
+    return fd;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void MEServerReadRequest( int fd, MEServerRequest & request )
+{
+    ParseRequest( ReadLine( fd ), request );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void MEServerWriteLine( int fd, const std::string & line )
+{
+    std::string data = line + "\n";
+
+    for (size_t offset = 0; offset < data.size(); )
+    {
+        ssize_t nSent = send( fd, data.data() + offset, data.size() - offset, SendFlags );
+        if (nSent < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            ThrowError( std::system_error( errno, std::generic_category(), "Failed to write to SherpaME server connection." ) );
+        }
+
+        offset += static_cast<size_t>(nSent);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The request line follows its length; the connection travels as SCM_RIGHTS data attached to the
+// length, so the receiver gets both in its first recvmsg.
+
+void MEServerSendConnection( int controlFd, int fd, const MEServerRequest & request )
+{
+    const std::string line   = RequestLine( request );
+    const uint32_t    length = static_cast<uint32_t>(line.size());
+
+    iovec iov[2];
+    iov[0].iov_base = const_cast<uint32_t *>(&length);
+    iov[0].iov_len  = sizeof(length);
+    iov[1].iov_base = const_cast<char *>(line.data());
+    iov[1].iov_len  = line.size();
+
+    union
+    {
+        char    buffer[CMSG_SPACE(sizeof(int))];
+        cmsghdr align;
+    } control;
+    memset( &control, 0, sizeof(control) );
+
+    msghdr message;
+    memset( &message, 0, sizeof(message) );
+    message.msg_iov         = iov;
+    message.msg_iovlen      = 2;
+    message.msg_control     = control.buffer;
+    message.msg_controllen  = sizeof(control.buffer);
+
+    cmsghdr * pHeader = CMSG_FIRSTHDR( &message );
+    pHeader->cmsg_level = SOL_SOCKET;
+    pHeader->cmsg_type  = SCM_RIGHTS;
+    pHeader->cmsg_len   = CMSG_LEN(sizeof(int));
+    memcpy( CMSG_DATA(pHeader), &fd, sizeof(int) );
+
+    ssize_t nSent = 0;
+    while ((nSent = sendmsg( controlFd, &message, SendFlags )) < 0)
+    {
+        if (errno != EINTR)
+            ThrowError( std::system_error( errno, std::generic_category(), "Failed to pass connection to SherpaME point process." ) );
+    }
+
+    // the rest of a partial send, without the connection
+
+    std::string data( reinterpret_cast<const char *>(&length), sizeof(length) );
+    data += line;
+
+    for (size_t offset = static_cast<size_t>(nSent); offset < data.size(); )
+    {
+        ssize_t nMore = send( controlFd, data.data() + offset, data.size() - offset, SendFlags );
+        if (nMore < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            ThrowError( std::system_error( errno, std::generic_category(), "Failed to pass connection to SherpaME point process." ) );
+        }
+
+        offset += static_cast<size_t>(nMore);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool MEServerReceiveConnection( int controlFd, int & fd, MEServerRequest & request )
+{
+    fd = -1;
+
+    uint32_t length = 0;
+
+    iovec iov;
+    iov.iov_base = &length;
+    iov.iov_len  = sizeof(length);
+
+    union
+    {
+        char    buffer[CMSG_SPACE(sizeof(int))];
+        cmsghdr align;
+    } control;
+    memset( &control, 0, sizeof(control) );
+
+    msghdr message;
+    memset( &message, 0, sizeof(message) );
+    message.msg_iov         = &iov;
+    message.msg_iovlen      = 1;
+    message.msg_control     = control.buffer;
+    message.msg_controllen  = sizeof(control.buffer);
+
+    ssize_t nRead = 0;
+    while ((nRead = recvmsg( controlFd, &message, 0 )) < 0)
+    {
+        if (errno != EINTR)
+            ThrowError( std::system_error( errno, std::generic_category(), "Failed to receive connection from SherpaME server." ) );
+    }
+
+    if (nRead == 0)
+        return false;   // the server has closed the socket
+
+    for (cmsghdr * pHeader = CMSG_FIRSTHDR( &message ); pHeader; pHeader = CMSG_NXTHDR( &message, pHeader ))
+    {
+        if ((pHeader->cmsg_level == SOL_SOCKET) && (pHeader->cmsg_type == SCM_RIGHTS))
+            memcpy( &fd, CMSG_DATA(pHeader), sizeof(int) );
+    }
+
+    try
+    {
+        if ((fd < 0) || (message.msg_flags & MSG_CTRUNC))
+            ThrowError( "SherpaME server message without its connection." );
+
+        ReadExact( controlFd, reinterpret_cast<char *>(&length) + nRead, sizeof(length) - static_cast<size_t>(nRead) );
+
+        std::string line( length, '\0' );
+        ReadExact( controlFd, &line[0], line.size() );
+
+        ParseRequest( line, request );
+    }
+    catch (...)
+    {
+        if (fd >= 0)
+            close( fd );
+        fd = -1;
+        throw;
+    }
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// client
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void MEServerEvaluate( const std::string & socketPath, const MEServerRequest & request,
+                       const MEStreamReader::RecordHandler & onRecord )
+{
+    std::string line = RequestLine( request );
+
+    int fd = Connect( socketPath );
+
+    try
+    {
+        MEServerWriteLine( fd, line );
+
+        std::string reply = ReadLine( fd );
+        if (reply != "OK")
+        {
+            std::vector<std::string> fields = SplitTabs( reply );
+            ThrowError( "SherpaME server (" + socketPath + ") failed: " + ((fields.size() > 1) ? fields[1] : reply) );
+        }
+
+        MEStreamReader reader;
+
+        char    buffer[1 << 16];
+        ssize_t nRead = 0;
+        while ((nRead = read( fd, buffer, sizeof(buffer) )) != 0)
+        {
+            if (nRead < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                ThrowError( std::system_error( errno, std::generic_category(), "Failed to read from SherpaME server connection." ) );
+            }
+
+            reader.Parse( buffer, static_cast<size_t>(nRead), onRecord );
+        }
+
+        if (!reader.Complete())
+            ThrowError( "Incomplete matrix element stream from SherpaME server (" + socketPath + "); see the server log." );
+    }
+    catch (...)
+    {
+        close( fd );
+        throw;
+    }
+
+    close( fd );
+}
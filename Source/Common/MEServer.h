@@ -0,0 +1,58 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//  MEServer.h
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ME_SERVER_H
+#define ME_SERVER_H
+
+#include "common.h"
+#include "MEStream.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Protocol of the SherpaME server (SherpaME --server), one request per connection on a Unix socket.
+//
+//  request:    EVAL <tab> input file [<tab> sherpa argument ...] \n
+//              QUIT \n                         (stops the server)
+//
+//  reply:      OK \n followed by an MEStream of one point with all events of the input file, in
+//              input order, written while the events are evaluated; a request failing after OK
+//              ends the stream without its end record (see MEStream.h)
+//              ERROR <tab> message \n          (the request failed before OK)
+//
+// The sherpa arguments select the parameter point; they are added to the arguments the server was
+// started with. Sherpa is initialized once per process, never torn down and initialized again, so
+// the server hands each connection to a point process forked for the point of the request. The
+// point process keeps Sherpa initialized for consecutive requests of its point; a request for
+// another point ends it and starts a new one, so for a series of different points (such as the
+// runs of a SherpaWeight job) only the process startup is saved.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct MEServerRequest
+{
+    bool                        bQuit       = false;
+    std::string                 inputFile;
+    std::vector<std::string>    sherpaArgs;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// server
+
+int  MEServerListen( const std::string & socketPath );     // returns listening socket, replacing any stale socket file
+
+void MEServerReadRequest( int fd, MEServerRequest & request );
+void MEServerWriteLine(   int fd, const std::string & line );
+
+// hand an accepted connection and its request to a point process over a Unix socket (controlFd);
+// the receiver owns the received connection and gets false once the sender has closed controlFd
+void MEServerSendConnection(    int controlFd, int fd, const MEServerRequest & request );
+bool MEServerReceiveConnection( int controlFd, int & fd, MEServerRequest & request );
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// client
+
+void MEServerEvaluate( const std::string & socketPath, const MEServerRequest & request,
+                       const MEStreamReader::RecordHandler & onRecord );      // throws on server error
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // ME_SERVER_H
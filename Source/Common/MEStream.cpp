@@ -0,0 +1,203 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//  MEStream.cpp
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "MEStream.h"
+
+#include "common.h"
+
+#include <limits>
+
+#include <unistd.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static const char    StreamMagic[4]  = { 'S', 'M', 'E', '2' };
+static const size_t  HeaderSize      = sizeof(StreamMagic) + sizeof(uint32_t);
+static const int32_t EndId           = std::numeric_limits<int32_t>::min();
+static const size_t  EndSize         = sizeof(int32_t) + sizeof(uint64_t);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// class MEStreamWriter
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool MEStreamWriter::ParseTarget( const std::string & target, int & fd )  // static
+{
+    if (target.compare( 0, 3, "fd:" ) != 0)
+        return false;
+
+    char * pEnd = nullptr;
+    long   value = strtol( target.c_str() + 3, &pEnd, 10 );
+    if ((pEnd == target.c_str() + 3) || *pEnd || (value < 0))
+        ThrowError( "Invalid stream target (" + target + "). Use fd:<n>." );
+
+    fd = static_cast<int>(value);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+MEStreamWriter::MEStreamWriter( int fd, size_t nPoints )
+    : m_fd( fd ), m_nPoints( nPoints )
+{
+    if (m_nPoints < 1)
+        ThrowError( std::invalid_argument( "MEStreamWriter: no points" ) );
+
+    m_buffer.reserve( 1 << 16 );
+
+    uint32_t npoint = static_cast<uint32_t>(m_nPoints);
+
+    m_buffer.insert( m_buffer.end(), StreamMagic, StreamMagic + sizeof(StreamMagic) );
+    m_buffer.insert( m_buffer.end(), reinterpret_cast<const char *>(&npoint), reinterpret_cast<const char *>(&npoint) + sizeof(npoint) );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+MEStreamWriter::~MEStreamWriter() throw()
+{
+    try
+    {
+        Close();
+    }
+    catch (...)
+    {
+        LogMsgError( "Failed to close matrix element stream." );
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void MEStreamWriter::Write( int32_t id, const double * pME )
+{
+    if (m_fd < 0)
+        ThrowError( "Write() called on closed matrix element stream." );
+
+    if (id == EndId)
+        ThrowError( "Event id " + std::to_string(id) + " is reserved in the matrix element stream." );
+
+    m_buffer.insert( m_buffer.end(), reinterpret_cast<const char *>(&id),  reinterpret_cast<const char *>(&id) + sizeof(id) );
+    m_buffer.insert( m_buffer.end(), reinterpret_cast<const char *>(pME), reinterpret_cast<const char *>(pME + m_nPoints) );
+
+    ++m_nRecords;
+
+    if (m_buffer.size() >= (1 << 16))
+        Flush();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void MEStreamWriter::Flush()
+{
+    const char * pData  = m_buffer.data();
+    size_t       nBytes = m_buffer.size();
+
+    while (nBytes)
+    {
+        ssize_t nWritten = write( m_fd, pData, nBytes );
+        if (nWritten < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            ThrowError( std::system_error( errno, std::generic_category(), "Failed to write matrix element stream." ) );
+        }
+
+        pData  += nWritten;
+        nBytes -= static_cast<size_t>(nWritten);
+    }
+
+    m_buffer.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void MEStreamWriter::Finish()
+{
+    if (m_fd < 0)
+        ThrowError( "Finish() called on closed matrix element stream." );
+
+    m_buffer.insert( m_buffer.end(), reinterpret_cast<const char *>(&EndId),      reinterpret_cast<const char *>(&EndId) + sizeof(EndId) );
+    m_buffer.insert( m_buffer.end(), reinterpret_cast<const char *>(&m_nRecords), reinterpret_cast<const char *>(&m_nRecords) + sizeof(m_nRecords) );
+
+    Close();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void MEStreamWriter::Close()
+{
+    if (m_fd < 0)
+        return;
+
+    Flush();
+
+    close( m_fd );
+    m_fd = -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// class MEStreamReader
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void MEStreamReader::Parse( const char * pData, size_t nBytes, const RecordHandler & onRecord )
+{
+    if (m_bEnd && nBytes)
+        ThrowError( "Data after the end of the matrix element stream." );
+
+    m_pending.insert( m_pending.end(), pData, pData + nBytes );
+
+    size_t offset = 0;
+
+    if (!m_bHeader)
+    {
+        if (m_pending.size() < HeaderSize)
+            return;
+
+        if (memcmp( m_pending.data(), StreamMagic, sizeof(StreamMagic) ) != 0)
+            ThrowError( "Invalid matrix element stream header." );
+
+        uint32_t npoint = 0;
+        memcpy( &npoint, m_pending.data() + sizeof(StreamMagic), sizeof(npoint) );
+        if (npoint < 1)
+            ThrowError( "Invalid number of points in matrix element stream." );
+
+        m_nPoints = npoint;
+        m_me.resize( m_nPoints );
+        m_bHeader = true;
+
+        offset = HeaderSize;
+    }
+
+    const size_t recordSize = sizeof(int32_t) + m_nPoints * sizeof(double);
+
+    while (m_pending.size() - offset >= sizeof(int32_t))
+    {
+        int32_t id = 0;
+        memcpy( &id, m_pending.data() + offset, sizeof(id) );
+
+        if (id == EndId)
+        {
+            if (m_pending.size() - offset < EndSize)
+                break;
+
+            uint64_t nrecord = 0;
+            memcpy( &nrecord, m_pending.data() + offset + sizeof(id), sizeof(nrecord) );
+            if (nrecord != m_nRecords)
+                ThrowError( "Matrix element stream ends after " + std::to_string(m_nRecords) + " of " + std::to_string(nrecord) + " records." );
+
+            if (m_pending.size() - offset > EndSize)
+                ThrowError( "Data after the end of the matrix element stream." );
+
+            m_bEnd = true;
+            offset += EndSize;
+            break;
+        }
+
+        if (m_pending.size() - offset < recordSize)
+            break;
+
+        memcpy( m_me.data(), m_pending.data() + offset + sizeof(id), m_nPoints * sizeof(double) );   // records are unaligned
+
+        onRecord( id, m_me.data(), m_nPoints );
+        ++m_nRecords;
+
+        offset += recordSize;
+    }
+
+    m_pending.erase( m_pending.begin(), m_pending.begin() + offset );
+}
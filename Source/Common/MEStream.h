@@ -0,0 +1,77 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//  MEStream.h
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ME_STREAM_H
+#define ME_STREAM_H
+
+#include "common.h"
+
+#include <functional>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Binary matrix element stream, used by SherpaME to send its results to SherpaWeight over a pipe
+// instead of a root file, and by the SherpaME server to reply to its clients.
+//
+//  header:     char     magic[4]   "SME2"
+//              uint32_t npoint
+//  records:    int32_t  id
+//              double   me[npoint]
+//  end:        int32_t  id         INT32_MIN, reserved for the end record
+//              uint64_t nrecord
+//
+// A stream is only complete with its end record (see MEStreamWriter::Finish), so a writer that
+// stops at a record boundary on an error still leaves an incomplete stream.
+// All values are packed in native byte order; the stream never leaves the machine.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class MEStreamWriter
+{
+public:
+    static bool ParseTarget( const std::string & target, int & fd );   // returns true for "fd:<n>"
+
+    MEStreamWriter( int fd, size_t nPoints );       // takes ownership of fd
+    ~MEStreamWriter() throw();
+
+    void Write( int32_t id, const double * pME );   // pME holds nPoints values
+
+    void Flush();
+    void Finish();                                  // write the end record and close
+    void Close();                                   // close without the end record, leaving the stream incomplete
+
+private:
+    int                 m_fd;
+    size_t              m_nPoints;
+    uint64_t            m_nRecords  = 0;
+    std::vector<char>   m_buffer;
+
+private:
+    MEStreamWriter(const MEStreamWriter &)              = delete;   // disable copy constructor
+    MEStreamWriter & operator=(const MEStreamWriter &)  = delete;   // disable assignment operator
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class MEStreamReader
+{
+public:
+    typedef std::function<void( int32_t id, const double * pME, size_t nPoints )> RecordHandler;
+
+    void Parse( const char * pData, size_t nBytes, const RecordHandler & onRecord );  // data in any chunks as read
+
+    bool     Complete()  const throw()  { return m_bEnd; }     // true once the end record was read
+    size_t   NPoints()   const throw()  { return m_nPoints;  }
+    uint64_t NRecords()  const throw()  { return m_nRecords; }
+
+private:
+    bool                m_bHeader   = false;
+    bool                m_bEnd      = false;
+    size_t              m_nPoints   = 0;
+    uint64_t            m_nRecords  = 0;
+    std::vector<char>   m_pending;
+    std::vector<double> m_me;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // ME_STREAM_H
@@ -0,0 +1,165 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//  MatrixElementCache.cpp
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "MatrixElementCache.h"
+
+#include "common.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// class MatrixElementCache
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const uint32_t MatrixElementCache::None;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void MatrixElementCache::Reset( size_t capacity )
+{
+    capacity = std::min( capacity, size_t(None - 1) );
+
+    size_t   tableSize = 2;
+    unsigned bits      = 1;
+    while (tableSize < 2 * capacity)    // at most half full, for short probe sequences
+    {
+        tableSize <<= 1;
+        ++bits;
+    }
+
+    std::vector<Slot>    ( capacity ).swap( m_slots );
+    std::vector<uint32_t>( capacity ? tableSize : 0, None ).swap( m_table );
+
+    m_shift = 64 - bits;
+    m_size  = 0;
+    m_head  = None;
+    m_tail  = None;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+size_t MatrixElementCache::Bucket( uint64_t eventHash ) const throw()
+{
+    return static_cast<size_t>((eventHash * 0x9E3779B97F4A7C15ull) >> m_shift);  // Fibonacci hashing spreads any input bits
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+uint32_t MatrixElementCache::Lookup( uint64_t eventHash, const EventFileVertex & vertex ) const throw()
+{
+    if (m_table.empty())
+        return None;
+
+    const size_t mask = m_table.size() - 1;
+
+    for (size_t b = Bucket( eventHash ); m_table[b] != None; b = (b + 1) & mask)
+    {
+        const Slot & entry = m_slots[ m_table[b] ];
+        if ((entry.eventHash == eventHash) && SameKinematics( entry.vertex, vertex ))
+            return m_table[b];
+    }
+
+    return None;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void MatrixElementCache::Unindex( uint32_t slot ) throw()
+{
+    const size_t mask = m_table.size() - 1;
+
+    size_t hole = Bucket( m_slots[slot].eventHash );
+    while (m_table[hole] != slot)
+        hole = (hole + 1) & mask;
+
+    // shift later entries of the probe sequence back into the hole, so lookups need no tombstones
+    for (size_t b = (hole + 1) & mask; m_table[b] != None; b = (b + 1) & mask)
+    {
+        size_t home = Bucket( m_slots[ m_table[b] ].eventHash );
+
+        bool bStays = (hole <= b) ? ((hole < home) && (home <= b)) : ((hole < home) || (home <= b));
+        if (bStays)
+            continue;
+
+        m_table[hole] = m_table[b];
+        hole = b;
+    }
+
+    m_table[hole] = None;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void MatrixElementCache::Unlink( uint32_t slot ) throw()
+{
+    Slot & entry = m_slots[slot];
+
+    if (entry.prev != None) m_slots[entry.prev].next = entry.next;
+    else                    m_head                   = entry.next;
+
+    if (entry.next != None) m_slots[entry.next].prev = entry.prev;
+    else                    m_tail                   = entry.prev;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void MatrixElementCache::PushFront( uint32_t slot ) throw()
+{
+    Slot & entry = m_slots[slot];
+
+    entry.prev = None;
+    entry.next = m_head;
+
+    if (m_head != None) m_slots[m_head].prev = slot;
+    else                m_tail               = slot;
+
+    m_head = slot;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool MatrixElementCache::Find( uint64_t eventHash, const EventFileVertex & vertex, double & me ) throw()
+{
+    uint32_t slot = Lookup( eventHash, vertex );
+    if (slot == None)
+        return false;
+
+    Unlink(    slot );   // now most recently used
+    PushFront( slot );
+
+    me = m_slots[slot].me;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void MatrixElementCache::Add( uint64_t eventHash, const EventFileVertex & vertex, double me )
+{
+    if (m_slots.empty())
+        return;
+
+    uint32_t slot = Lookup( eventHash, vertex );
+    if (slot != None)
+    {
+        m_slots[slot].me = me;
+        Unlink(    slot );
+        PushFront( slot );
+        return;
+    }
+
+    if (m_size < m_slots.size())
+    {
+        slot = static_cast<uint32_t>(m_size++);
+    }
+    else
+    {
+        slot = m_tail;      // evict least recently used
+        Unindex( slot );
+        Unlink(  slot );
+    }
+
+    m_slots[slot].eventHash = eventHash;
+    m_slots[slot].me        = me;
+    m_slots[slot].vertex    = vertex;   // reuses the capacity of the evicted vertex
+    PushFront( slot );
+
+    const size_t mask = m_table.size() - 1;
+
+    size_t b = Bucket( eventHash );
+    while (m_table[b] != None)
+        b = (b + 1) & mask;
+    m_table[b] = slot;
+}
@@ -0,0 +1,59 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//  MatrixElementCache.h
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MATRIX_ELEMENT_CACHE_H
+#define MATRIX_ELEMENT_CACHE_H
+
+#include "common.h"
+#include "EventFile.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// class MatrixElementCache
+//
+// Least recently used matrix elements keyed by event kinematics hash. A slot also keeps the vertex it
+// was added for, and a hash match only counts if the vertices agree, so a hash collision is a miss.
+// All slots are allocated by Reset, and a reused slot keeps the capacity of its vertex, so once the
+// slots are filled finding and adding do not allocate; the index is an open addressing table of slots.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class MatrixElementCache
+{
+public:
+    void Reset( size_t capacity );     // removes all entries
+
+    size_t Capacity() const throw()     { return m_slots.size(); }
+
+    bool Find( uint64_t eventHash, const EventFileVertex & vertex, double & me ) throw();
+    void Add(  uint64_t eventHash, const EventFileVertex & vertex, double me );
+
+private:
+    static const uint32_t None = 0xFFFFFFFF;
+
+    struct Slot
+    {
+        uint64_t        eventHash   = 0;
+        double          me          = 0;
+        uint32_t        prev        = 0;    // towards more recently used
+        uint32_t        next        = 0;    // towards less recently used
+        EventFileVertex vertex;
+    };
+
+    size_t   Bucket( uint64_t eventHash ) const throw();
+    uint32_t Lookup( uint64_t eventHash, const EventFileVertex & vertex ) const throw();
+    void     Unindex( uint32_t slot ) throw();
+    void     Unlink( uint32_t slot ) throw();
+    void     PushFront( uint32_t slot ) throw();
+
+private:
+    std::vector<Slot>       m_slots;
+    std::vector<uint32_t>   m_table;
+    unsigned                m_shift = 64;
+    size_t                  m_size  = 0;
+    uint32_t                m_head  = None;
+    uint32_t                m_tail  = None;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // MATRIX_ELEMENT_CACHE_H
@@ -0,0 +1,275 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//  MatrixElementStore.cpp
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "MatrixElementStore.h"
+
+#include "common.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static const char   StoreMagic[4]   = { 'S', 'M', 'S', '2' };
+static const size_t HeaderSize      = sizeof(StoreMagic) + sizeof(uint32_t);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// class MatrixElementStore
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+MatrixElementStore::MatrixElementStore( const std::string & directory )
+    : m_directory( directory )
+{
+    if (m_directory.empty())
+        ThrowError( std::invalid_argument( "MatrixElementStore: empty directory" ) );
+
+    if (m_directory.back() != '/')
+        m_directory += "/";
+
+    if ((mkdir( m_directory.c_str(), 0777 ) != 0) && (errno != EEXIST))
+        ThrowError( std::system_error( errno, std::generic_category(), "Failed to create ME store directory (" + m_directory + ")" ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+MatrixElementStore::~MatrixElementStore() throw()
+{
+    try
+    {
+        Flush();
+    }
+    catch (...)
+    {
+        LogMsgError( "Failed to flush ME store (%hs).", FMT_HS(m_directory.c_str()) );
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+std::string MatrixElementStore::ProcessFilePath() const
+{
+    char host[256] = {};
+    if (gethostname( host, sizeof(host) - 1 ) != 0)
+        strcpy( host, "localhost" );
+
+    return m_directory + "ME_" + m_pointKey + "." + host + "." + std::to_string( getpid() ) + ".dat";
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void MatrixElementStore::SelectPoint( const std::string & pointKey )
+{
+    if (pointKey == m_pointKey)
+        return;
+
+    Flush();
+
+    m_records.clear();
+    m_pointKey    = pointKey;
+    m_nFound      = 0;
+    m_nAdded      = 0;
+    m_nCollisions = 0;
+
+    // merge the files of all processes that wrote this point
+
+    const std::string prefix = "ME_" + m_pointKey + ".";
+    const std::string suffix = ".dat";
+
+    DIR * pDir = opendir( m_directory.c_str() );
+    if (!pDir)
+    {
+        LogMsgWarning( "Failed to open ME store directory (%hs).", FMT_HS(m_directory.c_str()) );
+        return;
+    }
+
+    size_t nFiles = 0;
+    while (struct dirent * pEntry = readdir( pDir ))
+    {
+        std::string name = pEntry->d_name;
+        if ((name.size() <= prefix.size() + suffix.size()) || (name.compare( 0, prefix.size(), prefix ) != 0) ||
+            (name.compare( name.size() - suffix.size(), suffix.size(), suffix ) != 0))
+            continue;
+
+        LoadFile( m_directory + name );
+        ++nFiles;
+    }
+
+    closedir( pDir );
+
+    LogMsgInfo( "ME store: %llu matrix elements for point %hs (%u files)", FMT_LLU(m_records.size()), FMT_HS(m_pointKey.c_str()), FMT_U(nFiles) );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Load the whole records of a point file. A trailing partial record, of a writer that was
+// interrupted or is still writing, is ignored; a file with an invalid header is skipped.
+
+void MatrixElementStore::LoadFile( const std::string & filePath )
+{
+    int fd = open( filePath.c_str(), O_RDONLY );
+    if (fd < 0)
+    {
+        LogMsgWarning( "Failed to open ME store file (%hs).", FMT_HS(filePath.c_str()) );
+        return;
+    }
+
+    char    header[HeaderSize];
+    ssize_t nHeader = read( fd, header, sizeof(header) );
+
+    uint32_t recordSize = 0;
+    if (nHeader == static_cast<ssize_t>(sizeof(header)))
+        memcpy( &recordSize, header + sizeof(StoreMagic), sizeof(recordSize) );
+
+    if ((nHeader != static_cast<ssize_t>(sizeof(header))) || (memcmp( header, StoreMagic, sizeof(StoreMagic) ) != 0) ||
+        (recordSize != sizeof(Record)))
+    {
+        if (nHeader != 0)   // an empty file is a writer that has not written its header yet
+            LogMsgWarning( "Skipping ME store file with invalid header (%hs).", FMT_HS(filePath.c_str()) );
+        close( fd );
+        return;
+    }
+
+    Record  records[4096];
+    ssize_t nRead = 0;
+    size_t  nPartial = 0;
+
+    while ((nRead = read( fd, reinterpret_cast<char *>(records) + nPartial, sizeof(records) - nPartial )) > 0)
+    {
+        size_t nBytes   = nPartial + static_cast<size_t>(nRead);
+        size_t nRecords = nBytes / sizeof(Record);
+
+        for (size_t i = 0; i < nRecords; ++i)
+            m_records.insert( std::make_pair( records[i].eventHash, Entry{ records[i].checkHash, records[i].me } ) );
+
+        nPartial = nBytes % sizeof(Record);
+        if (nPartial)
+            memmove( records, reinterpret_cast<char *>(records) + nRecords * sizeof(Record), nPartial );
+    }
+
+    if (nRead < 0)
+        LogMsgWarning( "Failed to read ME store file (%hs).", FMT_HS(filePath.c_str()) );
+
+    close( fd );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool MatrixElementStore::Find( uint64_t eventHash, uint64_t checkHash, double & me )
+{
+    auto itrFind = m_records.find( eventHash );
+    if (itrFind == m_records.end())
+        return false;
+
+    if (itrFind->second.checkHash != checkHash)
+    {
+        ++m_nCollisions;    // different kinematics with the same eventHash
+        return false;
+    }
+
+    me = itrFind->second.me;
+    ++m_nFound;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void MatrixElementStore::Add( uint64_t eventHash, uint64_t checkHash, double me )
+{
+    if (m_pointKey.empty())
+        ThrowError( "MatrixElementStore: Add() called before SelectPoint()." );
+
+    if (!m_records.insert( std::make_pair( eventHash, Entry{ checkHash, me } ) ).second)
+        return;     // already stored, or a collision that keeps the first record
+
+    m_pending.push_back( Record{ eventHash, checkHash, me } );
+    ++m_nAdded;
+
+    if (m_pending.size() >= 4096)
+        Flush();    // keep progress of long runs
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Append the pending records to the point file of this process. The file ends on a record
+// boundary after every flush: a trailing partial record left by an interrupted earlier process
+// of the same host and pid is truncated first, and a failed write is truncated back.
+
+void MatrixElementStore::Flush()
+{
+    if (m_pending.empty())
+        return;
+
+    const std::string filePath = ProcessFilePath();
+
+    int fd = open( filePath.c_str(), O_RDWR | O_CREAT, 0666 );
+    if (fd < 0)
+        ThrowError( std::system_error( errno, std::generic_category(), "Failed to open ME store file (" + filePath + ")" ) );
+
+    struct stat info;
+    if (fstat( fd, &info ) != 0)
+    {
+        int error = errno;
+        close( fd );
+        ThrowError( std::system_error( error, std::generic_category(), "Failed to read ME store file size (" + filePath + ")" ) );
+    }
+
+    std::vector<char> data;
+    data.reserve( HeaderSize + m_pending.size() * sizeof(Record) );
+
+    // a file without a valid header (another format, or an interrupted first flush) is started again
+
+    bool bHeader = false;
+    if (info.st_size >= static_cast<off_t>(HeaderSize))
+    {
+        char     header[HeaderSize] = {};
+        uint32_t recordSize = 0;
+
+        if (pread( fd, header, sizeof(header), 0 ) == static_cast<ssize_t>(sizeof(header)))
+            memcpy( &recordSize, header + sizeof(StoreMagic), sizeof(recordSize) );
+
+        bHeader = (memcmp( header, StoreMagic, sizeof(StoreMagic) ) == 0) && (recordSize == sizeof(Record));
+    }
+
+    off_t offset = 0;   // end of the last whole record
+    if (bHeader)
+    {
+        const off_t headerSize = static_cast<off_t>(HeaderSize);
+        const off_t recordSize = static_cast<off_t>(sizeof(Record));
+
+        offset = headerSize + (info.st_size - headerSize) / recordSize * recordSize;
+    }
+    else
+    {
+        uint32_t recordSize = sizeof(Record);
+
+        data.insert( data.end(), StoreMagic, StoreMagic + sizeof(StoreMagic) );
+        data.insert( data.end(), reinterpret_cast<const char *>(&recordSize), reinterpret_cast<const char *>(&recordSize) + sizeof(recordSize) );
+    }
+
+    data.insert( data.end(), reinterpret_cast<const char *>(m_pending.data()), reinterpret_cast<const char *>(m_pending.data() + m_pending.size()) );
+
+    int error = 0;
+    if ((offset != info.st_size) && (ftruncate( fd, offset ) != 0))
+        error = errno;
+
+    for (size_t nWritten = 0; !error && (nWritten < data.size()); )
+    {
+        ssize_t n = pwrite( fd, data.data() + nWritten, data.size() - nWritten, offset + static_cast<off_t>(nWritten) );
+        if (n < 0)
+        {
+            if (errno != EINTR)
+                error = errno;
+            continue;
+        }
+
+        nWritten += static_cast<size_t>(n);
+    }
+
+    if (error && (ftruncate( fd, offset ) != 0))
+        LogMsgWarning( "Failed to truncate ME store file (%hs).", FMT_HS(filePath.c_str()) );
+
+    close( fd );
+
+    m_pending.clear();
+
+    if (error)
+        ThrowError( std::system_error( error, std::generic_category(), "Failed to write ME store file (" + filePath + ")" ) );
+}
@@ -0,0 +1,82 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//  MatrixElementStore.h
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MATRIX_ELEMENT_STORE_H
+#define MATRIX_ELEMENT_STORE_H
+
+#include "common.h"
+
+#include <unordered_map>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// class MatrixElementStore
+//
+// Persistent on-disk store of calculated matrix elements, shared by all jobs using the same
+// directory. Each parameter point (model, parameter values and Sherpa setup) has a file per
+// writing process, ME_<point>.<host>.<pid>.dat, so no two processes ever append to the same file.
+// Selecting a point merges the files of all processes. A file holds a header and binary records
+// of two independent hashes of the event kinematics (see HashVertex and CheckHashVertex) and the
+// matrix element; a record is only found if both hashes match.
+//
+//  header:     char     magic[4]   "SMS2"
+//              uint32_t recordSize
+//  records:    uint64_t eventHash
+//              uint64_t checkHash
+//              double   me
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class MatrixElementStore
+{
+public:
+    explicit MatrixElementStore( const std::string & directory );  // creates directory if necessary
+    ~MatrixElementStore() throw();
+
+    const std::string & Directory() const throw()   { return m_directory; }
+    const std::string & PointKey()  const throw()   { return m_pointKey;  }
+
+    void SelectPoint( const std::string & pointKey );   // flushes the current point and loads the records of pointKey
+
+    bool Find( uint64_t eventHash, uint64_t checkHash, double & me );   // returns true if the matrix element is stored
+    void Add(  uint64_t eventHash, uint64_t checkHash, double me );
+
+    void Flush();                                       // append new records to the point file of this process
+
+    uint64_t NFound()      const throw()            { return m_nFound;      }  // counts for the current point
+    uint64_t NAdded()      const throw()            { return m_nAdded;      }
+    uint64_t NCollisions() const throw()            { return m_nCollisions; }  // lookups with a matching eventHash only
+
+private:
+    struct Record
+    {
+        uint64_t    eventHash;
+        uint64_t    checkHash;
+        double      me;
+    };
+
+    struct Entry
+    {
+        uint64_t    checkHash;
+        double      me;
+    };
+
+    std::string ProcessFilePath() const;                // point file of this process (evaluated after a fork)
+
+    void LoadFile( const std::string & filePath );
+
+    std::string                             m_directory;
+    std::string                             m_pointKey;
+    std::unordered_map<uint64_t, Entry>     m_records;
+    std::vector<Record>                     m_pending;
+    uint64_t                                m_nFound        = 0;
+    uint64_t                                m_nAdded        = 0;
+    uint64_t                                m_nCollisions   = 0;
+
+private:
+    MatrixElementStore(const MatrixElementStore &)              = delete;   // disable copy constructor
+    MatrixElementStore & operator=(const MatrixElementStore &)  = delete;   // disable assignment operator
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // MATRIX_ELEMENT_STORE_H
@@ -0,0 +1,30 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//  SherpaArgs.cpp
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "SherpaArgs.h"
+
+#include "common.h"
+
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+uint64_t PointArgsHash( const std::vector<std::string> & sherpaArgs, uint64_t hash /*= HashSeed*/ )
+{
+    static const char * const runFileArgs[] = { "OUTPUT=", "LOG_FILE=", "RESULT_DIRECTORY=", "EVENT_OUTPUT=", "INIT_ONLY=",
+                                                "FR_PARAMCARD=", "UFO_PARAM_CARD=" };
+    static const size_t       nCardArgs     = 2;    // the last entries, naming parameter cards
+
+    for (const std::string & arg : sherpaArgs)
+    {
+        auto itrRunFile = std::find_if( std::begin(runFileArgs), std::end(runFileArgs),
+                                        [&arg]( const char * prefix ) { return arg.compare( 0, strlen(prefix), prefix ) == 0; } );
+
+        if (itrRunFile == std::end(runFileArgs))
+            hash = HashString( arg, hash );
+        else if (itrRunFile >= std::end(runFileArgs) - nCardArgs)
+            hash = HashFile( arg.substr( strlen(*itrRunFile) ), hash );     // the card holds the parameter values
+    }
+
+    return hash;
+}
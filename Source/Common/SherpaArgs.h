@@ -0,0 +1,20 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//  SherpaArgs.h
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SHERPA_ARGS_H
+#define SHERPA_ARGS_H
+
+#include "common.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Hash identifying the parameter point of sherpa command line arguments (KEY=VALUE): arguments that
+// only name run files (output, log and result paths) are ignored, except that the contents of a
+// named parameter card are included. Used to key the ME store and the SherpaME server point.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t PointArgsHash( const std::vector<std::string> & sherpaArgs, uint64_t hash = HashSeed );
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // SHERPA_ARGS_H
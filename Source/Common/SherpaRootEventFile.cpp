@@ -21,7 +21,7 @@ public:
 
     virtual void GetSignalVertex( EventFileVertex & vertex ) const override;
 
-    virtual void SetCoefficients( const DoubleVector & coefs ) override;
+    virtual void SetCoefficients( const double * pCoefs, size_t nCoefs ) override;
 
 private:
     SherpaRootEvent m_event;
@@ -34,6 +34,15 @@ private:
 // class SherpaRootEventFile
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool SherpaRootEventFile::IsSupported( const std::string & fileName ) throw()  // static
+{
+    const std::string rootExtension( ".root" );
+
+    return (fileName.size() > rootExtension.size()) &&
+           (fileName.compare( fileName.size() - rootExtension.size(), rootExtension.size(), rootExtension ) == 0);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 SherpaRootEventFile::~SherpaRootEventFile() throw()
 {
@@ -203,6 +212,19 @@ bool SherpaRootEventFile::ReadEvent( EventFileEvent & vEvent )
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+uint64_t SherpaRootEventFile::SkipEvents( uint64_t nEvents )
+{
+    if (!m_pTree)
+        ThrowError( "SkipEvents() called on closed file." );
+
+    uint64_t nSkipped = std::min( nEvents, static_cast<uint64_t>( std::max(m_nEntries - m_iEntry, Long64_t(0)) ) );
+
+    m_iEntry += static_cast<Long64_t>(nSkipped);    // entries are random access
+
+    return nSkipped;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 void SherpaRootEventFile::SetCoefficientNames( const StringVector & coefNames )
 {
@@ -269,7 +291,8 @@ void SherpaRootEventFileEvent::Clear()
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 void SherpaRootEventFileEvent::GetSignalVertex( EventFileVertex & vertex ) const
 {
-    vertex = EventFileVertex();  // clear vertex
+    vertex.input .clear();      // clear vertex, keeping the capacity for the next event
+    vertex.output.clear();
 
     size_t nOutput = static_cast<size_t>(m_event.nparticle);
     vertex.output.resize( nOutput );
@@ -340,8 +363,8 @@ void SherpaRootEventFileEvent::GetSignalVertex( EventFileVertex & vertex ) const
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-void SherpaRootEventFileEvent::SetCoefficients( const DoubleVector & coefs )
+void SherpaRootEventFileEvent::SetCoefficients( const double * pCoefs, size_t nCoefs )
 {
-    m_coefs = coefs;
+    m_coefs.assign( pCoefs, pCoefs + nCoefs );  // recycled events keep their capacity
 }
 
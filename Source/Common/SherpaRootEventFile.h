@@ -38,6 +38,8 @@ public:
 
     virtual bool ReadEvent( EventFileEvent & event ) override;
 
+    virtual uint64_t SkipEvents( uint64_t nEvents ) override;
+
     virtual void SetCoefficientNames( const StringVector & coefNames ) override;
 
     virtual void WriteEvent( const EventFileEvent & event ) override;
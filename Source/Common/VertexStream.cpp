@@ -0,0 +1,258 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//  VertexStream.cpp
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "VertexStream.h"
+
+#include "common.h"
+
+#include <limits>
+
+#include <unistd.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static const size_t RecordHeaderSize    = sizeof(uint64_t) + sizeof(int32_t) + 2 * sizeof(uint16_t);
+static const size_t ParticleSize        = sizeof(int32_t) + 4 * sizeof(double);
+static const size_t StreamBufferSize    = 1 << 16;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+static inline char * PutValue( char * pData, const T & value ) throw()
+{
+    memcpy( pData, &value, sizeof(value) );     // records are unaligned
+    return pData + sizeof(value);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+static inline const char * GetValue( const char * pData, T & value ) throw()
+{
+    memcpy( &value, pData, sizeof(value) );
+    return pData + sizeof(value);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// class VertexStreamWriter
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void VertexStreamWriter::Encode( std::vector<char> & buffer, uint64_t entry, int32_t eventId, const EventFileVertex & vertex )  // static
+{
+    const size_t maxParticles = std::numeric_limits<uint16_t>::max();
+    if ((vertex.input.size() > maxParticles) || (vertex.output.size() > maxParticles))
+        ThrowError( "Too many particles in signal vertex of event " + std::to_string(eventId) + "." );
+
+    const uint16_t nInput  = static_cast<uint16_t>(vertex.input.size());
+    const uint16_t nOutput = static_cast<uint16_t>(vertex.output.size());
+
+    size_t offset = buffer.size();
+    buffer.resize( offset + RecordHeaderSize + (nInput + nOutput) * ParticleSize );
+
+    char * pData = buffer.data() + offset;
+
+    pData = PutValue( pData, entry   );
+    pData = PutValue( pData, eventId );
+    pData = PutValue( pData, nInput  );
+    pData = PutValue( pData, nOutput );
+
+    for (const std::vector<EventFileVertex::Particle> * pParticles : { &vertex.input, &vertex.output })
+    {
+        for (const EventFileVertex::Particle & part : *pParticles)
+        {
+            pData = PutValue( pData, part.pdg );
+            pData = PutValue( pData, part.E   );
+            pData = PutValue( pData, part.px  );
+            pData = PutValue( pData, part.py  );
+            pData = PutValue( pData, part.pz  );
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+VertexStreamWriter::VertexStreamWriter( int fd )
+    : m_fd( fd )
+{
+    m_buffer.reserve( 2 * StreamBufferSize );   // room for a full buffer plus the record crossing it
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+VertexStreamWriter::~VertexStreamWriter() throw()
+{
+    try
+    {
+        Close();
+    }
+    catch (...)
+    {
+        LogMsgError( "Failed to close vertex stream." );
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void VertexStreamWriter::Write( uint64_t entry, int32_t eventId, const EventFileVertex & vertex )
+{
+    if (m_fd < 0)
+        ThrowError( "Write() called on closed vertex stream." );
+
+    Encode( m_buffer, entry, eventId, vertex );
+    ++m_nRecords;
+
+    if (m_buffer.size() >= StreamBufferSize)
+        Flush();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void VertexStreamWriter::Flush()
+{
+    const char * pData  = m_buffer.data();
+    size_t       nBytes = m_buffer.size();
+
+    while (nBytes)
+    {
+        ssize_t nWritten = write( m_fd, pData, nBytes );
+        if (nWritten < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            ThrowError( std::system_error( errno, std::generic_category(), "Failed to write vertex stream." ) );
+        }
+
+        pData  += nWritten;
+        nBytes -= static_cast<size_t>(nWritten);
+    }
+
+    m_buffer.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void VertexStreamWriter::Close()
+{
+    if (m_fd < 0)
+        return;
+
+    Flush();
+
+    close( m_fd );
+    m_fd = -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// class VertexStreamReader
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+VertexStreamReader::VertexStreamReader( int fd )
+    : m_fd( fd ), m_buffer( StreamBufferSize )
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+VertexStreamReader::~VertexStreamReader() throw()
+{
+    Close();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void VertexStreamReader::Close() throw()
+{
+    if (m_fd >= 0)
+        close( m_fd );
+    m_fd = -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void VertexStreamReader::Rewind()
+{
+    if (lseek( m_fd, 0, SEEK_SET ) < 0)
+        ThrowError( std::system_error( errno, std::generic_category(), "Failed to rewind vertex stream." ) );
+
+    m_begin    = 0;
+    m_end      = 0;
+    m_nRecords = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool VertexStreamReader::Fill( size_t nBytes )
+{
+    if (m_end - m_begin >= nBytes)
+        return true;
+
+    if (m_fd < 0)
+        ThrowError( "Read() called on closed vertex stream." );
+
+    // move the unread data to the front, and only grow the buffer for a record larger than it
+
+    memmove( m_buffer.data(), m_buffer.data() + m_begin, m_end - m_begin );
+    m_end  -= m_begin;
+    m_begin = 0;
+
+    if (m_buffer.size() < nBytes)
+        m_buffer.resize( nBytes );
+
+    while (m_end < nBytes)
+    {
+        ssize_t nRead = read( m_fd, m_buffer.data() + m_end, m_buffer.size() - m_end );
+        if (nRead < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            ThrowError( std::system_error( errno, std::generic_category(), "Failed to read vertex stream." ) );
+        }
+
+        if (nRead == 0)
+            return false;
+
+        m_end += static_cast<size_t>(nRead);
+    }
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool VertexStreamReader::Read( uint64_t & entry, int32_t & eventId, EventFileVertex & vertex )
+{
+    if (!Fill( RecordHeaderSize ))
+    {
+        if (m_end == m_begin)
+            return false;
+        ThrowError( "Vertex stream ends in a partial record." );
+    }
+
+    uint16_t nInput  = 0;
+    uint16_t nOutput = 0;
+
+    const char * pData = m_buffer.data() + m_begin;
+
+    pData = GetValue( pData, entry   );
+    pData = GetValue( pData, eventId );
+    pData = GetValue( pData, nInput  );
+    pData = GetValue( pData, nOutput );
+
+    const size_t recordSize = RecordHeaderSize + (nInput + nOutput) * ParticleSize;
+
+    if (!Fill( recordSize ))
+        ThrowError( "Vertex stream ends in a partial record." );
+
+    pData = m_buffer.data() + m_begin + RecordHeaderSize;   // the buffer may have moved
+
+    vertex.input .resize( nInput  );    // keeps the capacity of the caller's vertex
+    vertex.output.resize( nOutput );
+
+    for (std::vector<EventFileVertex::Particle> * pParticles : { &vertex.input, &vertex.output })
+    {
+        for (EventFileVertex::Particle & part : *pParticles)
+        {
+            pData = GetValue( pData, part.pdg );
+            pData = GetValue( pData, part.E   );
+            pData = GetValue( pData, part.px  );
+            pData = GetValue( pData, part.py  );
+            pData = GetValue( pData, part.pz  );
+        }
+    }
+
+    m_begin += recordSize;
+    ++m_nRecords;
+
+    return true;
+}
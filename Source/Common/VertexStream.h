@@ -0,0 +1,83 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//  VertexStream.h
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef VERTEX_STREAM_H
+#define VERTEX_STREAM_H
+
+#include "common.h"
+#include "EventFile.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Binary stream of event signal vertices, used by SherpaME to replay parsed input events without
+// parsing the input file again.
+//
+//  records:    uint64_t entry              entry of the event in the input file
+//              int32_t  eventId
+//              uint16_t nInput
+//              uint16_t nOutput
+//              particles[nInput + nOutput]:
+//                  int32_t pdg
+//                  double  E, px, py, pz
+//
+// All values are packed in native byte order; the stream never leaves the machine.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class VertexStreamWriter
+{
+public:
+    static void Encode( std::vector<char> & buffer, uint64_t entry, int32_t eventId, const EventFileVertex & vertex );  // appends one record
+
+    explicit VertexStreamWriter( int fd );          // takes ownership of fd
+    ~VertexStreamWriter() throw();
+
+    void Write( uint64_t entry, int32_t eventId, const EventFileVertex & vertex );
+
+    void Flush();
+    void Close();
+
+    uint64_t NRecords() const throw()   { return m_nRecords; }
+
+private:
+    int                 m_fd;
+    uint64_t            m_nRecords  = 0;
+    std::vector<char>   m_buffer;
+
+private:
+    VertexStreamWriter(const VertexStreamWriter &)              = delete;   // disable copy constructor
+    VertexStreamWriter & operator=(const VertexStreamWriter &)  = delete;   // disable assignment operator
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class VertexStreamReader
+{
+public:
+    explicit VertexStreamReader( int fd );          // takes ownership of fd
+    ~VertexStreamReader() throw();
+
+    bool Read( uint64_t & entry, int32_t & eventId, EventFileVertex & vertex );  // returns false at the end of the stream
+
+    void Rewind();                                  // read a seekable stream (a file) again from its start
+    void Close() throw();
+
+    uint64_t NRecords() const throw()   { return m_nRecords; }
+
+private:
+    bool Fill( size_t nBytes );                     // returns false if the stream ends before nBytes are buffered
+
+private:
+    int                 m_fd;
+    uint64_t            m_nRecords  = 0;
+    std::vector<char>   m_buffer;
+    size_t              m_begin     = 0;            // unread data of m_buffer
+    size_t              m_end       = 0;
+
+private:
+    VertexStreamReader(const VertexStreamReader &)              = delete;   // disable copy constructor
+    VertexStreamReader & operator=(const VertexStreamReader &)  = delete;   // disable assignment operator
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // VERTEX_STREAM_H
@@ -145,6 +145,64 @@ inline void LogMsgError( const std::string & str ) throw()
     throw error;
 }
 
+/////////////////////////////////////////////////////////////////////////////
+// hash helpers (64-bit FNV-1a, stable across runs and platforms of equal endianness)
+
+const uint64_t HashSeed = 0xCBF29CE484222325ULL;
+
+inline uint64_t HashBytes( const void * pData, size_t nBytes, uint64_t hash = HashSeed ) throw()
+{
+    const unsigned char * pBytes = static_cast<const unsigned char *>(pData);
+    for (size_t i = 0; i < nBytes; ++i)
+    {
+        hash ^= pBytes[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+inline uint64_t HashString( const std::string & str, uint64_t hash = HashSeed ) throw()
+{
+    return HashBytes( str.c_str(), str.size() + 1, hash );  // include terminator to separate consecutive strings
+}
+
+template<typename T>
+inline uint64_t HashValue( const T & value, uint64_t hash = HashSeed ) throw()
+{
+    static_assert( std::is_arithmetic<T>::value, "HashValue requires an arithmetic type" );
+    return HashBytes( &value, sizeof(value), hash );
+}
+
+inline uint64_t HashFile( const std::string & filePath, uint64_t hash = HashSeed ) throw()   // contents of the file; a missing file hashes as empty
+{
+    FILE * pFile = fopen( filePath.c_str(), "rb" );
+    if (!pFile)
+        return hash;
+
+    char   buffer[1 << 14];
+    size_t nRead = 0;
+    while ((nRead = fread( buffer, 1, sizeof(buffer), pFile )) > 0)
+        hash = HashBytes( buffer, nRead, hash );
+
+    fclose( pFile );
+    return hash;
+}
+
+inline uint64_t HashMix64( uint64_t value ) throw()    // splitmix64 finalizer, a mixing step independent of FNV-1a
+{
+    value ^= value >> 30;
+    value *= 0xBF58476D1CE4E5B9ULL;
+    value ^= value >> 27;
+    value *= 0x94D049BB133111EBULL;
+    value ^= value >> 31;
+    return value;
+}
+
+inline std::string HashToString( uint64_t hash )
+{
+    return StringFormat( "%016llx", static_cast<unsigned long long>(hash) );
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // string format helpers
 
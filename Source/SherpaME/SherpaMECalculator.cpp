@@ -4,6 +4,8 @@
 
 #include "SherpaMECalculator.h"
 
+#include "common.h"
+
 #include <sstream>
 #include <algorithm>
 
@@ -28,9 +30,55 @@
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-SherpaMECalculator::SherpaMECalculator(SHERPA::Sherpa *a_Generator)
+SherpaProcessIndex::SherpaProcessIndex(SHERPA::Sherpa *a_Generator)
+{
+    SHERPA::Matrix_Element_Handler * me_handler = a_Generator->GetInitHandler()->GetMatrixElementHandler();
+
+    for (size_t i = 0; i < me_handler->ProcMaps().size(); ++i)
+    {
+        PHASIC::NLOTypeStringProcessMap_Map::const_iterator sit(me_handler->ProcMaps()[i]->begin());
+        for ( ; sit != me_handler->ProcMaps()[i]->end(); ++sit)
+        {
+            const PHASIC::StringProcess_Map * const stringMap = sit->second;
+
+            for (PHASIC::StringProcess_Map::const_iterator it = stringMap->begin(); it !=stringMap->end(); ++it)
+            {
+                PHASIC::Process_Base * proc = it->second;
+                m_procs[SignatureHash(proc->NIn(), proc->Flavours())].push_back(proc);
+            }
+        }
+    }
+}
+
+uint64_t SherpaProcessIndex::SignatureHash(size_t nin, const ATOOLS::Flavour_Vector &flavs)
+{
+    uint64_t hash = HashValue<uint64_t>(nin);
+    for (size_t i = 0; i < flavs.size(); ++i)
+        hash = HashValue<long long>(flavs[i].IsAnti() ? -(long long)flavs[i].Kfcode() : (long long)flavs[i].Kfcode(), hash);
+    return hash;
+}
+
+PHASIC::Process_Base* SherpaProcessIndex::Find(size_t nin, const ATOOLS::Flavour_Vector &flavs) const
+{
+    Signature_Map::const_iterator fit = m_procs.find(SignatureHash(nin, flavs));
+    if (fit == m_procs.end())
+        return NULL;
+
+    // resolve hash collisions as the full scan does: first process in ProcMaps order
+    for (PHASIC::Process_Base * proc : fit->second)
+    {
+        if ((proc->NIn() == nin) && (proc->Flavours() == flavs))
+            return proc;
+    }
+
+    return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+SherpaMECalculator::SherpaMECalculator(SHERPA::Sherpa *a_Generator, const SherpaProcessIndex *a_Index)
   : m_name(""), p_amp(ATOOLS::Cluster_Amplitude::New()),
-    p_gen(a_Generator), p_proc(NULL), m_ncolinds(0),
+    p_gen(a_Generator), p_index(a_Index), p_proc(NULL), m_ncolinds(0),
     //m_npsp(0),
     m_nin(0), m_nout(0)
 {
@@ -38,6 +86,7 @@ SherpaMECalculator::SherpaMECalculator(SHERPA::Sherpa *a_Generator)
 
 SherpaMECalculator::~SherpaMECalculator() throw()
 {
+    if (p_amp) p_amp->Delete();   // returns the amplitude and its legs to the Sherpa pool
 }
 
 bool SherpaMECalculator::HasColorIntegrator()
@@ -187,6 +236,12 @@ void SherpaMECalculator::SetMomenta(const ATOOLS::Vec4D_Vector &p)
     for (size_t i(m_nin);i<p.size();i++) p_amp->Leg(m_mom_inds[i])->SetMom( p[i]);
 }
 
+void SherpaMECalculator::SetMomenta(const ATOOLS::Vec4D *p)
+{
+    for (size_t i(0);i<m_nin;i++)             p_amp->Leg(m_mom_inds[i])->SetMom(-p[i]);
+    for (size_t i(m_nin);i<m_nin+m_nout;i++)  p_amp->Leg(m_mom_inds[i])->SetMom( p[i]);
+}
+
 #ifdef UNUSED
 void SherpaMECalculator::SetMomentum(const size_t &index, const double &e,
                             const double &px, const double &py,
@@ -260,19 +315,19 @@ double SherpaMECalculator::GenerateColorPoint()
 
 void SherpaMECalculator::SetColors()
 {
-    PHASIC::Int_Vector ci(p_amp->Legs().size());
-    PHASIC::Int_Vector cj(p_amp->Legs().size());
+    m_ci.resize(p_amp->Legs().size());
+    m_cj.resize(p_amp->Legs().size());
     SP(PHASIC::Color_Integrator) CI = (p_proc->Integrator()->ColorIntegrator());
     if (CI==0)
         THROW(fatal_error, "No color integrator. Make sure Comix is used.");
     CI->GeneratePoint();
     for (size_t i=0; i<p_amp->Legs().size(); ++i)
     {
-        ci[i] = p_amp->Leg(i)->Col().m_i;
-        cj[i] = p_amp->Leg(i)->Col().m_j;
+        m_ci[i] = p_amp->Leg(i)->Col().m_i;
+        m_cj[i] = p_amp->Leg(i)->Col().m_j;
     }
-    CI->SetI(ci);
-    CI->SetJ(cj);
+    CI->SetI(m_ci);
+    CI->SetJ(m_cj);
 }
 
 PHASIC::Process_Base* SherpaMECalculator::FindProcess()
@@ -326,6 +381,9 @@ PHASIC::Process_Base* SherpaMECalculator::FindProcess()
     }
 #endif
 
+    if (p_index)
+        return p_index->Find(p_amp->NIn(), matchFlavours);
+
     // try to find match by legs
     
     //std::cout << "Searching for process by flavours: " << matchFlavours << std::endl;
@@ -426,37 +484,7 @@ void SherpaMECalculator::Initialize()
     
     if (m_ncolinds%2) THROW(fatal_error, "Odd number of color indices");
     
-    for (int i(0); i<pow(3, m_ncolinds); i++)
-    {
-        int k(i);
-        int mod(0);
-        int r(0), g(0), b(0);
-        int rb(0), gb(0), bb(0);
-        std::vector<int> combination;
-        for (size_t m(0); m<m_ncolinds/2; m++)
-        {
-            mod  = k%3;
-            switch(mod) {
-                case 0: r+=1;
-                case 1: g+=1;
-                case 2: b+=1;
-            }
-            combination.push_back(mod+1);
-            k = (k-mod)/3;
-        }
-        for (size_t m(m_ncolinds/2); m<m_ncolinds; m++)
-        {
-            mod  = k%3;
-            switch(mod) {
-                case 0: rb+=1;
-                case 1: gb+=1;
-                case 2: bb+=1;
-            }
-            combination.push_back(mod+1);
-            k = (k-mod)/3;
-        }
-        if (rb==r&&gb==g&&bb==b) m_colcombinations.push_back(combination);
-    }
+    m_colclasses = ColorClasses(m_ncolinds);
     
     std::vector<int> allpdgs;
     for (std::vector<int>::const_iterator it=m_inpdgs.begin();
@@ -482,6 +510,32 @@ double SherpaMECalculator::MatrixElement()
     return res;
 }
 
+void SherpaMECalculator::SetColorCombination(const std::vector<int> &combination)
+{
+    size_t ind(0);
+    size_t indbar(m_ncolinds/2);
+    std::vector<size_t>::const_iterator jt;
+    for(jt=m_gluinds.begin(); jt!=m_gluinds.end(); ++jt)
+    {
+        p_amp->Leg(*jt)->SetCol(ATOOLS::ColorID(combination[ind], combination[indbar]));
+        ind+=1;
+        indbar+=1;
+    }
+    for(jt=m_quainds.begin(); jt!=m_quainds.end(); ++jt)
+    {
+        p_amp->Leg(*jt)->SetCol(ATOOLS::ColorID(combination[ind], 0));
+        ind+=1;
+    }
+    for(jt=m_quabarinds.begin(); jt!=m_quabarinds.end(); ++jt)
+    {
+        p_amp->Leg(*jt)->SetCol(ATOOLS::ColorID(0,combination[indbar] ));
+        indbar+=1;
+    }
+    if(ind!=m_ncolinds/2)  THROW(fatal_error, "Internal Error");
+    if(indbar!=m_ncolinds) THROW(fatal_error, "Internal Error");
+    SetColors();
+}
+
 double SherpaMECalculator::CSMatrixElement()
 {
     if (!HasColorIntegrator())
@@ -492,35 +546,85 @@ double SherpaMECalculator::CSMatrixElement()
     double r_csme(0.);
 
     std::vector<std::vector<int> >::const_iterator it;
-    std::vector<size_t>::const_iterator jt;
-    for (it=m_colcombinations.begin(); it!=m_colcombinations.end(); ++it)
+    std::vector<double>::const_iterator wt(m_colclasses->multiplicities.begin());
+    for (it=m_colclasses->combinations.begin(); it!=m_colclasses->combinations.end(); ++it, ++wt)
     {
-        size_t ind(0);
-        size_t indbar(m_ncolinds/2);
-        for(jt=m_gluinds.begin(); jt!=m_gluinds.end(); ++jt)
-        {
-            p_amp->Leg(*jt)->SetCol(ATOOLS::ColorID((*it)[ind], (*it)[indbar]));
-            ind+=1;
-            indbar+=1;
-        }
-        for(jt=m_quainds.begin(); jt!=m_quainds.end(); ++jt)
+        SetColorCombination(*it);
+        r_csme+=(*wt)*p_proc->Differential(*p_amp);
+    }
+    
+    ci->SetWOn(true);
+    return r_csme;
+}
+
+// Same sums as CSMatrixElement for each point, with the colour loop outside the point loop,
+// so each colour configuration is set up once per batch instead of once per point.
+void SherpaMECalculator::CSMatrixElements(const ATOOLS::Vec4D *p, size_t n, double *mes)
+{
+    const size_t nlegs(m_nin+m_nout);
+
+    if (!HasColorIntegrator())
+    {
+        for (size_t e(0); e<n; e++)
         {
-            p_amp->Leg(*jt)->SetCol(ATOOLS::ColorID((*it)[ind], 0));
-            ind+=1;
+            SetMomenta(p + e*nlegs);
+            mes[e] = p_proc->Differential(*p_amp);
         }
-        for(jt=m_quabarinds.begin(); jt!=m_quabarinds.end(); ++jt)
+        return;
+    }
+
+    SP(PHASIC::Color_Integrator) ci(p_proc->Integrator()->ColorIntegrator());
+    ci->SetWOn(false);
+
+    std::fill(mes, mes + n, 0.);
+
+    std::vector<std::vector<int> >::const_iterator it;
+    std::vector<double>::const_iterator wt(m_colclasses->multiplicities.begin());
+    for (it=m_colclasses->combinations.begin(); it!=m_colclasses->combinations.end(); ++it, ++wt)
+    {
+        SetColorCombination(*it);
+        for (size_t e(0); e<n; e++)
         {
-            p_amp->Leg(*jt)->SetCol(ATOOLS::ColorID(0,(*it)[indbar] ));
-            indbar+=1;
+            SetMomenta(p + e*nlegs);
+            mes[e]+=(*wt)*p_proc->Differential(*p_amp);
         }
-        if(ind!=m_ncolinds/2)  THROW(fatal_error, "Internal Error");
-        if(indbar!=m_ncolinds) THROW(fatal_error, "Internal Error");
-        SetColors();
-        r_csme+=p_proc->Differential(*p_amp);
     }
-    
+
     ci->SetWOn(true);
-    return r_csme;
+}
+
+// Estimate the colour sum from colour points of the colour integrator, until the statistical
+// error is below relprec of a non-zero estimate (after at least 10 points) or maxpoints are used.
+// Ten vanishing colour points do not stop the sampling: they may all miss the contributing flows.
+double SherpaMECalculator::SampledCSMatrixElement(double relprec, size_t maxpoints, double &error)
+{
+    error = 0.;
+
+    if (!HasColorIntegrator())
+        return p_proc->Differential(*p_amp);
+
+    SP(PHASIC::Color_Integrator) ci(p_proc->Integrator()->ColorIntegrator());
+    ci->SetWOn(false);
+
+    const size_t minpoints(10);
+
+    double sum(0.), sum2(0.), mean(0.);
+    size_t n(0);
+    while (n<std::max(maxpoints, (size_t)1))
+    {
+        double x = GenerateColorPoint()*p_proc->Differential(*p_amp);
+        sum  += x;
+        sum2 += x*x;
+        n    += 1;
+
+        mean  = sum/n;
+        error = (n>1) ? sqrt(std::max(0., (sum2/n - mean*mean)/(n-1))) : 0.;
+
+        if (n>=minpoints && mean!=0. && error<=relprec*std::abs(mean)) break;
+    }
+
+    ci->SetWOn(true);
+    return mean;
 }
 
 #ifdef UNUSED
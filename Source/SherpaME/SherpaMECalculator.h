@@ -7,6 +7,11 @@
 
 #include <vector>
 #include <string>
+#include <unordered_map>
+#include <memory>
+#include <cstdint>
+
+#include "ColorClasses.h"
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Sherpa include files
@@ -34,6 +39,25 @@ namespace PHASIC
     class Process_Base;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Index of the initialized processes by flavour signature, built once per Sherpa initialization
+// and shared by the calculators.
+class SherpaProcessIndex
+{
+private:
+    typedef std::vector<PHASIC::Process_Base *>                     Process_Vector;
+    typedef std::unordered_map<uint64_t, Process_Vector>            Signature_Map;
+
+    Signature_Map                   m_procs;    // processes in ProcMaps order, per signature hash
+
+    static uint64_t SignatureHash(size_t nin, const ATOOLS::Flavour_Vector &flavs);
+
+public:
+    SherpaProcessIndex(SHERPA::Sherpa * Generator);
+
+    PHASIC::Process_Base * Find(size_t nin, const ATOOLS::Flavour_Vector &flavs) const;
+};
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 class SherpaMECalculator
 {
@@ -41,13 +65,15 @@ private:
     std::string                     m_name;
     ATOOLS::Cluster_Amplitude *     p_amp;
     SHERPA::Sherpa *                p_gen;
+    const SherpaProcessIndex *      p_index;
     PHASIC::Process_Base *          p_proc;
 
     size_t                          m_ncolinds;
-    std::vector<std::vector<int> >  m_colcombinations;
+    ColorClassesPtr                 m_colclasses;
     std::vector<size_t>             m_gluinds, m_quainds, m_quabarinds;
     std::vector<int>                m_inpdgs, m_outpdgs;
     std::vector<size_t>             m_mom_inds;
+    std::vector<int>                m_ci, m_cj;         // colour indices passed to the colour integrator
 
   //size_t                          m_npsp;
     size_t                          m_nin;
@@ -55,10 +81,12 @@ private:
 
     void SetMomentumIndices(const std::vector<int> &pdgs);
 
+    void SetColorCombination(const std::vector<int> &combination);
+
     PHASIC::Process_Base * FindProcess();
 
 public:
-    SherpaMECalculator(SHERPA::Sherpa * Generator);
+    SherpaMECalculator(SHERPA::Sherpa * Generator, const SherpaProcessIndex * Index = NULL);  // without Index, scan ProcMaps
     ~SherpaMECalculator() throw();
 
     void AddInFlav(  const int & id);
@@ -77,12 +105,17 @@ public:
   //void SetMomenta(size_t n);
   //void SetMomenta(const std::vector<double *> & p);
     void SetMomenta(const ATOOLS::Vec4D_Vector & p);
+    void SetMomenta(const ATOOLS::Vec4D * p);               // nin + nout momenta
   //void SetMomentum(const size_t & id, const double & E , const double & px,
   //                                    const double & py, const double & pz);
   //void SetMomentum(const size_t & id, const ATOOLS::Vec4D & p);
 
     double MatrixElement();
     double CSMatrixElement();
+    double SampledCSMatrixElement(double relprec, size_t maxpoints, double &error);   // Monte Carlo colour sum
+
+    // colour-summed matrix elements of n phase space points, p holds n blocks of nin + nout momenta
+    void CSMatrixElements(const ATOOLS::Vec4D * p, size_t n, double * mes);
 
   //double GetFlux();
   
@@ -0,0 +1,344 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//  SherpaMEEvaluator.cpp
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "SherpaMEEvaluator.h"
+
+#include "SherpaMECalculator.h"
+#include "MatrixElementStore.h"
+#include "SherpaArgs.h"
+#include "EventFile.h"
+#include "AllocationCounter.h"
+
+#include "common.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Sherpa include files
+
+#include <SHERPA/Main/Sherpa.H>
+#include <SHERPA/Initialization/Initialization_Handler.H>
+#include <MODEL/Main/Model_Base.H>
+#include <ATOOLS/Org/Exception.H>
+#include <ATOOLS/Math/Vector.H>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// class SherpaMEEvaluator
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The working buffers of EventMEs. They keep their capacity across calls, and the
+// event list of a subprocess is emptied rather than erased, so once every subprocess has been
+// seen the event loop does not allocate.
+
+struct SherpaMEEvaluator::Buffers
+{
+    std::map<std::vector<int>, std::vector<size_t>> groups;         // event indices per subprocess key (nIn, particle codes)
+    std::vector<uint64_t>                           eventHashes;
+    std::vector<uint64_t>                           checkHashes;    // second vertex hash for the store (see CheckHashVertex)
+    std::vector<unsigned char>                      bDone;          // matrix element already known
+    std::vector<std::pair<uint64_t, size_t>>        misses;         // (hash, event) of cache misses, sorted to find repeats
+    std::vector<std::pair<size_t, size_t>>          repeats;        // (event, first event with the same kinematics)
+    std::vector<int>                                key;
+    std::vector<int>                                codes;
+    ATOOLS::Vec4D_Vector                            momenta;
+    std::vector<double>                             results;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+SherpaMEEvaluator::SherpaMEEvaluator( SHERPA::Sherpa * pSherpa )
+    : m_pSherpa( pSherpa ), m_upBuffers( new Buffers )
+{
+    if (!m_pSherpa)
+        ThrowError( std::invalid_argument( "SherpaMEEvaluator: null Sherpa framework" ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+SherpaMEEvaluator::~SherpaMEEvaluator() throw()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void SherpaMEEvaluator::AttachStore( MatrixElementStore * pStore, const std::vector<std::string> & sherpaArgs )
+{
+    m_pStore = pStore;
+    if (!m_pStore)
+        return;
+
+    SHERPA::Initialization_Handler * pInitHandler = m_pSherpa->GetInitHandler();
+    if (!pInitHandler || !pInitHandler->GetModel())
+        ThrowError( "AttachStore: Sherpa framework is not initialized." );
+
+    MODEL::Model_Base * pModel = pInitHandler->GetModel();
+
+    // sherpa setup
+
+    uint64_t hash = HashString( pInitHandler->Path() );
+    hash = HashString( pInitHandler->File(), hash );
+
+    std::string runFile = pInitHandler->File();
+    hash = HashFile( pInitHandler->Path() + runFile.substr( 0, runFile.find('|') ), hash );    // processes, scales and other settings of the run file
+
+    hash = PointArgsHash( sherpaArgs, hash );
+
+    // model and parameter values of the initialized framework
+
+    hash = HashString( pModel->Name(), hash );
+
+    if (const auto * pConstants = pModel->GetScalarConstants())
+    {
+        for (const auto & constant : *pConstants)
+        {
+            hash = HashString( constant.first,  hash );
+            hash = HashValue(  constant.second, hash );
+        }
+    }
+
+    if (const auto * pConstants = pModel->GetComplexConstants())
+    {
+        for (const auto & constant : *pConstants)
+        {
+            hash = HashString( constant.first,         hash );
+            hash = HashValue(  constant.second.real(), hash );
+            hash = HashValue(  constant.second.imag(), hash );
+        }
+    }
+
+    m_pStore->SelectPoint( HashToString( hash ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void SherpaMEEvaluator::SetColorSampling( double relPrecision, size_t maxPoints /*= 10000*/ )
+{
+    m_colorPrecision = relPrecision;
+    m_colorMaxPoints = maxPoints;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void SherpaMEEvaluator::SetDuplicateCache( size_t capacity )
+{
+    m_cache.Reset( capacity );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool SherpaMEEvaluator::CacheFind( uint64_t eventHash, const EventFileVertex & vertex, double & me )
+{
+    ++m_nCacheLookups;
+
+    if (!m_cache.Find( eventHash, vertex, me ))
+        return false;
+
+    ++m_nCacheHits;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void SherpaMEEvaluator::EventMEs( const EventFileVertex * const * ppVertex, size_t nEvents, double * pME, double * pError /*= nullptr*/ )
+{
+    if (pError)
+        std::fill_n( pError, nEvents, 0.0 );
+
+    // group the events by subprocess (nIn, particle codes), keeping stored matrix elements;
+    // evaluating a subprocess at a time keeps its process state warm
+
+    const bool bUseStore = m_pStore && !ColorSampling();   // the store and cache only hold exact matrix elements
+    const bool bUseCache = (m_cache.Capacity() > 0) && !ColorSampling();
+
+    Buffers & buf = *m_upBuffers;
+
+    for (auto & group : buf.groups)
+        group.second.clear();
+
+    buf.bDone  .assign( nEvents, false );
+    buf.misses .clear();
+    buf.repeats.clear();
+
+    if (bUseStore || bUseCache)
+    {
+        buf.eventHashes.resize( nEvents );
+        for (size_t i = 0; i < nEvents; ++i)
+            buf.eventHashes[i] = HashVertex( *ppVertex[i] );
+    }
+
+    if (bUseStore)
+    {
+        buf.checkHashes.resize( nEvents );
+        for (size_t i = 0; i < nEvents; ++i)
+            buf.checkHashes[i] = CheckHashVertex( *ppVertex[i] );
+    }
+
+    if (bUseCache)
+    {
+        for (size_t i = 0; i < nEvents; ++i)
+        {
+            if (CacheFind( buf.eventHashes[i], *ppVertex[i], pME[i] ))
+                buf.bDone[i] = true;
+            else
+                buf.misses.push_back( std::make_pair( buf.eventHashes[i], i ) );
+        }
+
+        // repeats within this call are evaluated once, for their first event;
+        // events of equal hash are only repeats if their kinematics agree
+
+        std::sort( buf.misses.begin(), buf.misses.end() );
+
+        size_t first = 0;   // first miss with the hash of miss k
+        for (size_t k = 1; k < buf.misses.size(); ++k)
+        {
+            if (buf.misses[k].first != buf.misses[first].first)
+            {
+                first = k;
+                continue;
+            }
+
+            const size_t event = buf.misses[k].second;
+
+            for (size_t j = first; j < k; ++j)
+            {
+                const size_t earlier = buf.misses[j].second;
+                if (!buf.bDone[earlier] && SameKinematics( *ppVertex[earlier], *ppVertex[event] ))
+                {
+                    buf.bDone[event] = true;
+                    buf.repeats.push_back( std::make_pair( event, earlier ) );
+                    ++m_nCacheHits;
+                    break;
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < nEvents; ++i)
+    {
+        if (buf.bDone[i])
+            continue;
+
+        if (bUseStore && m_pStore->Find( buf.eventHashes[i], buf.checkHashes[i], pME[i] ))
+            continue;
+
+        const EventFileVertex & vertex = *ppVertex[i];
+
+        if (vertex.input.empty())
+            ThrowError( std::invalid_argument( "EventMEs: invalid number of input particles 0" ) );
+
+        buf.key.clear();
+        buf.key.push_back( static_cast<int>(vertex.input.size()) );
+        for (const EventFileVertex::Particle & part : vertex.input)
+            buf.key.push_back( part.pdg );
+        for (const EventFileVertex::Particle & part : vertex.output)
+            buf.key.push_back( part.pdg );
+
+        buf.groups[buf.key].push_back( i );
+    }
+
+    // evaluate each subprocess in one batch, writing the results back in input order
+
+    for (const auto & group : buf.groups)
+    {
+        const std::vector<int> &    groupKey    = group.first;
+        const std::vector<size_t> & events      = group.second;
+
+        if (events.empty())
+            continue;
+
+        const size_t nIn = static_cast<size_t>(groupKey[0]);
+        buf.codes.assign( groupKey.begin() + 1, groupKey.end() );
+
+        SherpaMECalculator & meCalc = Calculator( nIn, buf.codes );
+
+        buf.momenta.clear();
+        for (size_t i : events)
+        {
+            for (const EventFileVertex::Particle & part : ppVertex[i]->input)
+                buf.momenta.push_back( ATOOLS::Vec4D( part.E, part.px, part.py, part.pz ) );
+            for (const EventFileVertex::Particle & part : ppVertex[i]->output)
+                buf.momenta.push_back( ATOOLS::Vec4D( part.E, part.px, part.py, part.pz ) );
+        }
+
+        if (ColorSampling())
+        {
+            // each event samples its own colour points
+            const size_t nLegs = buf.codes.size();
+
+            for (size_t j = 0; j < events.size(); ++j)
+            {
+                double               error = 0;
+                AllocationCountPause pause;     // Sherpa's allocations are not the evaluator's
+
+                meCalc.SetMomenta( buf.momenta.data() + j * nLegs );
+                pME[ events[j] ] = meCalc.SampledCSMatrixElement( m_colorPrecision, m_colorMaxPoints, error );
+
+                if (pError)
+                    pError[ events[j] ] = error;
+            }
+            continue;
+        }
+
+        buf.results.resize( events.size() );
+        {
+            AllocationCountPause pause;     // Sherpa's allocations are not the evaluator's
+            meCalc.CSMatrixElements( buf.momenta.data(), events.size(), buf.results.data() );
+        }
+
+        for (size_t j = 0; j < events.size(); ++j)
+        {
+            pME[ events[j] ] = buf.results[j];
+
+            if (bUseStore)
+            {
+                AllocationCountPause pause;     // store records grow by design
+                m_pStore->Add( buf.eventHashes[ events[j] ], buf.checkHashes[ events[j] ], buf.results[j] );
+            }
+            if (bUseCache)
+                m_cache.Add( buf.eventHashes[ events[j] ], *ppVertex[ events[j] ], buf.results[j] );
+        }
+    }
+
+    for (const auto & repeat : buf.repeats)
+        pME[ repeat.first ] = pME[ repeat.second ];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The process lookup, colour combinations and momentum indices of a calculator only depend on the
+// flavours, so each subprocess gets a calculator on its first event and later events reuse it.
+
+SherpaMECalculator & SherpaMEEvaluator::Calculator( size_t nInParticles, const std::vector<int> & particleCodes )
+{
+    m_calculatorKey.clear();
+    m_calculatorKey.push_back( static_cast<int>(nInParticles) );
+    m_calculatorKey.insert( m_calculatorKey.end(), particleCodes.begin(), particleCodes.end() );
+
+    auto itrFind = m_calculators.find( m_calculatorKey );
+    if (itrFind != m_calculators.end())
+        return *itrFind->second;
+
+    AllocationCountPause pause;     // a new subprocess sets up Sherpa's process state
+
+    if (!m_upProcessIndex)
+        m_upProcessIndex.reset( new SherpaProcessIndex( m_pSherpa ) );
+
+    std::unique_ptr<SherpaMECalculator> upCalc( new SherpaMECalculator( m_pSherpa, m_upProcessIndex.get() ) );
+    SherpaMECalculator & meCalc = *upCalc;
+
+    for (size_t i = 0; i < particleCodes.size(); ++i)
+    {
+        if (i < nInParticles)
+            meCalc.AddInFlav( particleCodes[i] );
+        else
+            meCalc.AddOutFlav( particleCodes[i] );
+    }
+
+    try
+    {
+        meCalc.Initialize();
+    }
+    catch (const ATOOLS::Exception & error)
+    {
+        LogMsgError( "Sherpa exception caught: \"%hs\" in %hs::%hs",
+            FMT_HS(error.Info().c_str()), FMT_HS(error.Class().c_str()), FMT_HS(error.Method().c_str()) );
+        
+        LogMsgInfo( "Sherpa process name: \"%hs\"", FMT_HS(meCalc.Name().c_str()) );
+
+        throw;  // the subprocess is not cached, so a later event retries it
+    }
+
+    return *m_calculators.insert( std::make_pair( m_calculatorKey, std::move(upCalc) ) ).first->second;
+}
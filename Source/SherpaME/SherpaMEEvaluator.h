@@ -0,0 +1,90 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//  SherpaMEEvaluator.h
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SHERPA_ME_EVALUATOR_H
+#define SHERPA_ME_EVALUATOR_H
+
+#include "common.h"
+#include "EventFile.h"
+#include "MatrixElementCache.h"
+
+#include <map>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// forward declarations
+
+namespace SHERPA
+{
+class Sherpa;
+}
+
+class  MatrixElementStore;
+class  SherpaMECalculator;
+class  SherpaProcessIndex;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// class SherpaMEEvaluator
+//
+// Calculates the matrix element of an event's signal vertex with an initialized Sherpa framework.
+// Used by all modes of the SherpaME program (single point, points file, workers and server).
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class SherpaMEEvaluator
+{
+public:
+    explicit SherpaMEEvaluator( SHERPA::Sherpa * pSherpa );
+    ~SherpaMEEvaluator() throw();
+
+    // matrix elements of nEvents events, evaluated in batches per subprocess; pError may be null
+    // (statistical errors if colour sampled, else 0)
+    void EventMEs( const EventFileVertex * const * ppVertex, size_t nEvents, double * pME, double * pError = nullptr );
+
+    // sample the colour sum to the given relative precision instead of summing every colour
+    // configuration (0 = exact sum); sampled matrix elements bypass the store
+    void SetColorSampling( double relPrecision, size_t maxPoints = 10000 );
+    bool ColorSampling() const throw()      { return m_colorPrecision > 0; }
+
+    // keep the last capacity exact matrix elements in memory, keyed by the event kinematics,
+    // so repeated phase space points are not evaluated again (0 = disabled)
+    void SetDuplicateCache( size_t capacity );
+
+    uint64_t NCacheLookups() const throw()  { return m_nCacheLookups; }
+    uint64_t NCacheHits()    const throw()  { return m_nCacheHits;    }
+
+    // consult and fill pStore; the store point is keyed by the run file contents, the model parameters
+    // of the initialized framework and sherpaArgs, ignoring arguments that only name run files
+    void AttachStore( MatrixElementStore * pStore, const std::vector<std::string> & sherpaArgs );
+
+private:
+    SherpaMECalculator & Calculator( size_t nInParticles, const std::vector<int> & particleCodes );
+
+    bool CacheFind( uint64_t eventHash, const EventFileVertex & vertex, double & me );
+
+private:
+    typedef std::map<std::vector<int>, std::unique_ptr<SherpaMECalculator>>    CalculatorMap;  // key: nIn, particle codes
+
+    struct Buffers;
+
+    SHERPA::Sherpa *        m_pSherpa;
+    MatrixElementStore *    m_pStore    = nullptr;
+    double                  m_colorPrecision    = 0;
+    size_t                  m_colorMaxPoints    = 0;
+    std::unique_ptr<SherpaProcessIndex> m_upProcessIndex;   // built with the first calculator
+    CalculatorMap           m_calculators;      // one per subprocess, valid for the lifetime of the Sherpa initialization
+    std::vector<int>        m_calculatorKey;
+
+    std::unique_ptr<Buffers> m_upBuffers;       // working buffers of EventMEs, kept across calls
+
+    MatrixElementCache      m_cache;
+    uint64_t                m_nCacheLookups     = 0;
+    uint64_t                m_nCacheHits        = 0;
+
+private:
+    SherpaMEEvaluator(const SherpaMEEvaluator &)              = delete;   // disable copy constructor
+    SherpaMEEvaluator & operator=(const SherpaMEEvaluator &)  = delete;   // disable assignment operator
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // SHERPA_ME_EVALUATOR_H
@@ -7,8 +7,14 @@
 #include "SherpaRootEventFile.h"
 #include "HepMCEventFile.h"
 #include "MERootEvent.h"
+#include "MEStream.h"
+#include "MEServer.h"
+#include "SherpaArgs.h"
+#include "VertexStream.h"
 
-#include "SherpaMECalculator.h"
+#include "SherpaMEEvaluator.h"
+#include "MatrixElementStore.h"
+#include "AllocationCounter.h"
 
 #include "common.h"
 
@@ -18,269 +24,2001 @@
 // Sherpa includes
 #include <SHERPA/Main/Sherpa.H>
 #include <ATOOLS/Org/Exception.H>
-#include <ATOOLS/Math/Vector.H>
+#include <ATOOLS/Org/CXXFLAGS.H>   // USING__MPI
 
 // Root includes
 #include <TFile.h>
 #include <TTree.h>
+#include <RVersion.h>
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+#include <TROOT.h>
+#else
+#include <TThread.h>
+#endif
 
 // OpenMPI includes
 #include <mpi.h>
 
-////////////////////////////////////////////////////////////////////////////////////////////////////
-// class SherpaMEProgram
-////////////////////////////////////////////////////////////////////////////////////////////////////
+#include <fstream>
+#include <numeric>
+#include <limits>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-SherpaMEProgram::SherpaMEProgram()
+// The share of the input events read by one MPI rank: a block of entries if the number of events
+// is known (root files), otherwise every size-th event starting at the rank (HepMC files).
+
+class EventShard
 {
-    // initialize MPI (required if sherpa was compiled with --enable-mpi configure option)
-    MPI::Init();
+public:
+    EventShard( uint64_t nEvents, int rank, int size )
+    {
+        if (nEvents)
+        {
+            m_first  = nEvents *  rank      / size;
+            m_last   = nEvents * (rank + 1) / size;
+        }
+        else
+        {
+            m_first  = static_cast<uint64_t>(rank);
+            m_stride = static_cast<uint64_t>(size);
+        }
+    }
 
-    m_upSherpa.reset( new SHERPA::Sherpa );
-}
+    bool ReadEvent( EventFileInterface & file, EventFileEvent & event, uint64_t & entry )  // returns false if no more events
+    {
+        uint64_t target = Entry( m_nRead );
+        if (target >= m_last)
+            return false;
+
+        AllocationCountPause pause;     // parsing and decompression allocate in the file format libraries
+
+        uint64_t nSkip = target - m_position;
+        if (file.SkipEvents( nSkip ) != nSkip)
+            return false;
+
+        if (!file.ReadEvent( event ))
+            return false;
+
+        m_position = target + 1;
+        ++m_nRead;
+
+        entry = target;
+        return true;
+    }
+
+    bool ReadVertex( EventFileInterface & file, EventFileEvent & event, uint64_t & entry, int32_t & eventId, EventFileVertex & vertex )
+    {
+        if (!ReadEvent( file, event, entry ))
+            return false;
+
+        eventId = event.eventId;
+        event.GetSignalVertex( vertex );
+        return true;
+    }
+
+    uint64_t Entry( uint64_t index ) const throw()     // entry of the index-th event of the rank's share
+    {
+        return m_first + index * m_stride;
+    }
+
+private:
+    uint64_t    m_first     = 0;
+    uint64_t    m_last      = std::numeric_limits<uint64_t>::max();
+    uint64_t    m_stride    = 1;
+    uint64_t    m_position  = 0;    // entry of the next event in the file
+    uint64_t    m_nRead     = 0;
+};
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-SherpaMEProgram::~SherpaMEProgram() throw()
+// Open an input file with the reader of its type: root files of Sherpa events, which are sharded
+// by blocks of entries, or HepMC text files (any other name), which are read sequentially.
+
+static std::unique_ptr<EventFileInterface> OpenInputFile( const std::string & fileName )
 {
-    try
+    std::unique_ptr<EventFileInterface> upFile;
+
+    if (SherpaRootEventFile::IsSupported( fileName ))
     {
-        m_upSherpa.reset();
+        // the input tree is read on the reader thread of the event pipeline while the output tree
+        // is filled on its writer thread, so root file access from more than one thread must be enabled
+        static std::once_flag rootThreadsFlag;
+        std::call_once( rootThreadsFlag, []()
+        {
+        #if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+            ROOT::EnableThreadSafety();
+        #else
+            TThread::Initialize();
+        #endif
+        } );
+
+        upFile.reset( new SherpaRootEventFile );
     }
-    catch (...)
+    else
     {
-        LogMsgError( "Unexpected exception while terminating Sherpa framework." );
+        upFile.reset( new HepMCEventFile );
     }
 
-    // finalize MPI (required if sherpa was compiled with --enable-mpi configure option)
-    MPI::Finalize();
+    upFile->Open( fileName, EventFileInterface::OpenMode::Read );
+    return upFile;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-int SherpaMEProgram::ParseCommandLine( int argc, const char * argv[], RunParameters & param )
+// Append the data of all other MPI ranks to the data of rank 0, in rank order.
+
+template<typename T>
+static void GatherToRoot( std::vector<T> & data )
 {
-    param = RunParameters();  // clear all values in case of error
+    const int       rank        = MPI::COMM_WORLD.Get_rank();
+    const int       size        = MPI::COMM_WORLD.Get_size();
+    const int       tag         = 1;
+    const size_t    maxChunk    = (size_t(1) << 30) / sizeof(T);   // MPI counts are int
 
-    if (argc < 3)
-        goto USAGE;
-    
-    param.argv.push_back( argv[0] );
+    if (rank != 0)
+    {
+        uint64_t count = data.size();
+        MPI::COMM_WORLD.Send( &count, sizeof(count), MPI::BYTE, 0, tag );
 
-    param.inputRootFileName  = argv[1];
-    param.outputRootFileName = argv[2];
- 
-    if (param.inputRootFileName.empty() || param.outputRootFileName.empty())
-        goto USAGE;
-    
-    if (param.inputRootFileName == param.outputRootFileName)
+        for (size_t i = 0; i < data.size(); i += maxChunk)
+            MPI::COMM_WORLD.Send( data.data() + i, static_cast<int>(std::min( maxChunk, data.size() - i ) * sizeof(T)), MPI::BYTE, 0, tag );
+
+        data.clear();
+        return;
+    }
+
+    for (int source = 1; source < size; ++source)
     {
-        LogMsgError( "Output root file cannot be the same as the input root file." );
-        return -1;
+        uint64_t count = 0;
+        MPI::COMM_WORLD.Recv( &count, sizeof(count), MPI::BYTE, source, tag );
+
+        size_t offset = data.size();
+        data.resize( offset + count );
+
+        for (size_t i = offset; i < data.size(); i += maxChunk)
+            MPI::COMM_WORLD.Recv( data.data() + i, static_cast<int>(std::min( maxChunk, data.size() - i ) * sizeof(T)), MPI::BYTE, source, tag );
     }
-    
-    for (int a = 3; a < argc; ++a)
-        param.argv.push_back( argv[a] );
+}
 
-    return 0;
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static std::vector<size_t> EntryOrder( const std::vector<uint64_t> & entries )
+{
+    std::vector<size_t> order( entries.size() );
+    std::iota( order.begin(), order.end(), size_t(0) );
+    std::sort( order.begin(), order.end(), [&entries]( size_t a, size_t b ) { return entries[a] < entries[b]; } );
+    return order;
+}
 
- USAGE:
-    LogMsgInfo("Usage: SherpaME input_root_file output_root_file <sherpa_arguments ...>");
-    return -1;
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Resident memory of this process in bytes, 0 if unavailable.
+
+static uint64_t ResidentMemory()
+{
+#if defined(__APPLE__)
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info( mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count ) != KERN_SUCCESS)
+        return 0;
+    return info.resident_size;
+#else
+    std::ifstream statm( "/proc/self/statm" );
+    uint64_t size = 0, resident = 0;
+    if (!(statm >> size >> resident))
+        return 0;
+    return resident * static_cast<uint64_t>(sysconf( _SC_PAGESIZE ));
+#endif
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-int SherpaMEProgram::Run( const RunParameters & param )
+// Soak test of long runs: logs the resident memory every million events and fails at the end if it
+// grew by more than 5% over the value after the first million, by which time the caches are full.
+
+class MemoryMonitor
 {
-    try
+public:
+    static const uint64_t ReportInterval = 1000000;
+
+    void Count( uint64_t nEvents )
     {
-        time_t timeStartRun = time(nullptr);
+        m_nEvents += nEvents;
+        if (m_nEvents < m_nextReport)
+            return;
 
-        // initialize sherpa
-        {
-            std::vector<const char *> runArgv(param.argv);
+        m_nextReport += ReportInterval;
 
-          //runArgv.push_back( "OUTPUT=15" );
-            runArgv.push_back( "INIT_ONLY=2"   );   // prevent Sherpa from starting the cross section integration
-            runArgv.push_back( "EVENT_OUTPUT=" );   // prevent Sherpa from overwriting any event file specified in the dat file
+        uint64_t resident = ResidentMemory();
+        if (m_baseline == 0)
+            m_baseline = resident;
+        m_last = resident;
+
+        LogMsgInfo( "Soak: %llu events, resident memory %.1f MB", FMT_LLU(m_nEvents), FMT_F(resident / 1048576.0) );
+    }
 
-            if (!m_upSherpa->InitializeTheRun( static_cast<int>(runArgv.size()), const_cast<char **>(runArgv.data()) ))
-                ThrowError( "Failed to initialize Sherpa framework. Check Run.dat file." );
+    void Check() const
+    {
+        if ((m_baseline == 0) || (m_nEvents < 2 * ReportInterval))
+        {
+            LogMsgWarning( "Soak: too few events (%llu) to check the resident memory.", FMT_LLU(m_nEvents) );
+            return;
         }
 
-        // open input file
+        if (static_cast<double>(m_last) > 1.05 * static_cast<double>(m_baseline))
+            ThrowError( "Soak test failed: resident memory grew from " + std::to_string(m_baseline / 1048576) + " MB to " +
+                        std::to_string(m_last / 1048576) + " MB." );
 
-        LogMsgInfo( "Input file : %hs", FMT_HS(param.inputRootFileName.c_str()) );
-        //SherpaRootEventFile inputFile;
-        HepMCEventFile inputFile;
-        inputFile.Open( param.inputRootFileName, EventFileInterface::OpenMode::Read );
+        LogMsgInfo( "Soak: resident memory flat (%.1f MB to %.1f MB).", FMT_F(m_baseline / 1048576.0), FMT_F(m_last / 1048576.0) );
+    }
 
-        // create output file
+private:
+    uint64_t    m_nEvents       = 0;
+    uint64_t    m_nextReport    = ReportInterval;
+    uint64_t    m_baseline      = 0;
+    uint64_t    m_last          = 0;
+};
 
-        LogMsgInfo( "Output file: %hs", FMT_HS(param.outputRootFileName.c_str()) );
-        std::unique_ptr<TFile> upOutputFile( new TFile( param.outputRootFileName.c_str(), "RECREATE" ) );
-        if (upOutputFile->IsZombie() || !upOutputFile->IsOpen())    // IsZombie is true if constructor failed
-        {
-            LogMsgError( "Failed to create output file (%hs).", FMT_HS(param.outputRootFileName.c_str()) );
-            ThrowError( std::invalid_argument( param.outputRootFileName ) );
-        }
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Counts the heap allocations of one pipeline stage per window in debug builds (see
+// AllocationCounter.h). After the warm-up a stage is expected to reuse its buffers, so a window
+// that still allocates fails the run rather than leaving a warning in a long log.
 
-        // create output tree
+class StageAllocations
+{
+public:
+    static const uint64_t WarmUpWindows = 16;
 
-        TTree * pOutputTree( new TTree( "SherpaME", "SherpaME" ) );   // owned by current directory
-        if (pOutputTree->IsZombie())
-            ThrowError("Failed to construct output tree.");
+    explicit StageAllocations( const char * stage ) : m_stage( stage ) {}
 
-        pOutputTree->SetDirectory( upOutputFile.get() );   // attach to output file, output file now owns tree and will call delete
-        pOutputTree->SetAutoSave(0);                       // disable autosave
+    void Begin() throw()
+    {
+        m_nStart = AllocationCount();
+    }
 
-        // create event containers
+    void End( size_t nEvents )
+    {
+        if (!AllocationCounting() || (++m_nWindows <= WarmUpWindows))
+            return;
 
-        EventFileEvent::UniquePtr   upInputEvent    = inputFile.AllocateEvent();
-        EventFileEvent &            inputEvent      = *upInputEvent;
-        EventFileVertex             inputVertex;
-        MERootEvent                 outputEvent;
+        uint64_t nAllocs = AllocationCount() - m_nStart;
+        if (nAllocs)
+            ThrowError( std::string(m_stage) + " made " + std::to_string(nAllocs) + " allocations in a window of " +
+                        std::to_string(nEvents) + " events after the warm-up. Its buffers should be reused." );
 
-        outputEvent.SetOutputTree( pOutputTree );
-        
-        // loop through and process each input event
+        m_nWarmEvents += nEvents;
+    }
 
-        uint64_t    iEvent          = 1;
-        uint64_t    nEvents         = inputFile.Count();
-        uint64_t    logFrequency    = 1;
-        uint32_t    logCount        = 0;
+    void Log() const
+    {
+        if (m_nWarmEvents)
+            LogMsgInfo( "%hs allocations after warm-up: none in %llu events", FMT_HS(m_stage), FMT_LLU(m_nWarmEvents) );
+    }
 
-        if (nEvents)
-            LogMsgInfo( "\nGetting matrix elements for %llu events ...", FMT_LLU(nEvents) );
-        else
-            LogMsgInfo( "\nGetting matrix elements for events ..." );
+private:
+    const char *    m_stage;
+    uint64_t        m_nStart        = 0;
+    uint64_t        m_nWindows      = 0;
+    uint64_t        m_nWarmEvents   = 0;
+};
 
-        time_t timeStartProcess = time(nullptr);
-        
-        for ( ; inputFile.ReadEvent( inputEvent ); ++iEvent)
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// class EventPipeline
+//
+// A ring of preallocated event windows passed through three stages: a reader thread fills each
+// window from the input file (decompression and parsing), the calling thread evaluates it, and a
+// writer thread passes on the results (output tree fill and compression). Sherpa only waits for
+// the input or output while the ring is empty or full. The stages hand over whole windows, so
+// the lock is taken once per window rather than once per event.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class EventPipeline
+{
+public:
+    struct BlockEvent
+    {
+        uint64_t                entry;
+        int32_t                 eventId;
+        EventFileVertex         vertex;
+    };
+
+    struct Window
+    {
+        std::vector<BlockEvent>             events;
+        std::vector<const EventFileVertex*> vertices;   // of events, for SherpaMEEvaluator::EventMEs
+        std::vector<double>                 me;
+        std::vector<double>                 error;
+        size_t                              count = 0;
+    };
+
+    typedef std::function<bool( Window & window )> StageHandler;   // the reader returns false after the last event
+
+    EventPipeline( size_t nWindows, size_t windowSize )
+        : m_windows( std::max( nWindows, size_t(2) ) )
+    {
+        for (Window & window : m_windows)
         {
-            inputEvent.GetSignalVertex( inputVertex );
+            window.events  .resize( windowSize );
+            window.vertices.resize( windowSize );
+            window.me      .resize( windowSize );
+            window.error   .resize( windowSize );
 
-            if (!ProcessEvent( inputEvent.eventId, inputVertex, outputEvent ))
-                continue;
+            for (size_t i = 0; i < windowSize; ++i)
+                window.vertices[i] = &window.events[i].vertex;
+        }
+    }
 
-            if (iEvent % logFrequency == 0)
+    void Run( const StageHandler & onRead, const StageHandler & onCompute, const StageHandler & onWrite )  // rethrows the first error of any stage
+    {
+        std::thread reader;
+        std::thread writer;
+
+        try
+        {
+            reader = std::thread( &EventPipeline::RunStage, this, StageRead,  std::cref(onRead)  );
+            writer = std::thread( &EventPipeline::RunStage, this, StageWrite, std::cref(onWrite) );
+        }
+        catch (...)
+        {
+            Abort( std::current_exception() );
+        }
+
+        RunStage( StageCompute, onCompute );
+
+        if (reader.joinable())
+            reader.join();
+        if (writer.joinable())
+            writer.join();
+
+        if (m_error)
+            std::rethrow_exception( m_error );
+    }
+
+private:
+    enum Stage { StageRead, StageCompute, StageWrite, StageCount };
+
+    bool Ready( size_t stage ) const    // the next window of stage is available; call with lock held
+    {
+        if (stage == StageRead)
+            return m_nDone[StageRead] - m_nDone[StageWrite] < m_windows.size();
+        return m_nDone[stage] < m_nDone[stage - 1];
+    }
+
+    void RunStage( size_t stage, const StageHandler & onWindow )
+    {
+        try
+        {
+            for (;;)
             {
-                if (++logCount == 10)
+                Window * pWindow = nullptr;
                 {
-                    logFrequency *= 10;
-                    logCount      = 1;
-                }
-
-                LogMsgInfo( "Event %llu (id %i): ME = %E", FMT_LLU(iEvent), FMT_I(upInputEvent->eventId), FMT_F(outputEvent.me) );
-            }
+                    std::unique_lock<std::mutex> lock( m_mutex );
+                    m_condition.wait( lock, [this, stage]()
+                    {
+                        return m_bAbort || Ready( stage ) || ((stage != StageRead) && m_bFinished[stage - 1]);
+                    } );
 
-            if (pOutputTree->Fill() < 0)
-                ThrowError( "Fill failed on event " + std::to_string(iEvent) );
-        }
+                    if (m_bAbort || !Ready( stage ))
+                        break;
 
-        // write and close the output file (not really necessary as would be done in destructor)
-        
-        upOutputFile->Write( 0, TFile::kOverwrite );
-        upOutputFile->Close();
+                    pWindow = &m_windows[ m_nDone[stage] % m_windows.size() ];
+                }
 
-        time_t timeStopProcess = time(nullptr);
+                if (!onWindow( *pWindow ))
+                    break;
 
-        LogMsgInfo( "%llu events completed. (%u seconds)", FMT_LLU(iEvent-1), FMT_U(timeStopProcess - timeStartProcess) );
-        LogMsgInfo( "Done. (%u seconds)", FMT_U(timeStopProcess - timeStartRun) );
+                {
+                    std::lock_guard<std::mutex> lock( m_mutex );
+                    ++m_nDone[stage];
+                }
+                m_condition.notify_all();
+            }
+        }
+        catch (...)
+        {
+            Abort( std::current_exception() );
+        }
 
-        return EXIT_SUCCESS;
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            m_bFinished[stage] = true;
+        }
+        m_condition.notify_all();
     }
-    catch (const ATOOLS::Exception & error)
+
+    void Abort( std::exception_ptr error )
     {
-        LogMsgError( "Sherpa Exception: %hs\n\t[Source %hs::%hs]",
-                    FMT_HS(error.Info().c_str()), FMT_HS(error.Class().c_str()), FMT_HS(error.Method().c_str()) );
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            if (!m_error)
+                m_error = error;
+            m_bAbort = true;
+        }
+        m_condition.notify_all();
     }
 
-    return EXIT_FAILURE;
-}
+private:
+    std::vector<Window>         m_windows;
+    std::mutex                  m_mutex;
+    std::condition_variable     m_condition;
+    uint64_t                    m_nDone[StageCount]     = { 0, 0, 0 };    // windows completed by each stage
+    bool                        m_bFinished[StageCount] = { false, false, false };
+    bool                        m_bAbort                = false;
+    std::exception_ptr          m_error;
+};
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-bool SherpaMEProgram::ProcessEvent( int32_t eventId, const EventFileVertex & inputEvent, MERootEvent & outputEvent )
-{
-    outputEvent = MERootEvent();  // clear values
+// The output of the matrix elements: a root file, or a binary record stream if the output file name
+// is fd:<n>, a pipe or file descriptor opened by the parent process (see MEStream.h).
+// The root tree holds an MERootEvent per event, or an MEPointsRootEvent in multi-point mode.
+// The stream has no room for the error of colour-sampled matrix elements.
 
-    // define the flavors and momenta
-    std::vector<int>     particles;
-    ATOOLS::Vec4D_Vector momenta;
+class MEOutput
+{
+public:
+    MEOutput( const std::string & fileName, size_t nPoints, bool bPointsTree, bool bError = false )
+        : m_nPoints( nPoints )
     {
-        for (const EventFileVertex::Particle & part : inputEvent.input)
-        {
-            ATOOLS::Vec4D P_part( part.E, part.px, part.py, part.pz );
+        LogMsgInfo( "Output file: %hs", FMT_HS(fileName.c_str()) );
 
-            particles.push_back( part.pdg );
-            momenta  .push_back( P_part   );
+        int fd = -1;
+        if (MEStreamWriter::ParseTarget( fileName, fd ))
+        {
+            m_upStream.reset( new MEStreamWriter( fd, nPoints ) );
+            return;
         }
 
-        for (const EventFileVertex::Particle & part : inputEvent.output)
+        m_upFile.reset( new TFile( fileName.c_str(), "RECREATE" ) );
+        if (m_upFile->IsZombie() || !m_upFile->IsOpen())    // IsZombie is true if constructor failed
         {
-            ATOOLS::Vec4D P_part( part.E, part.px, part.py, part.pz );
+            LogMsgError( "Failed to create output file (%hs).", FMT_HS(fileName.c_str()) );
+            ThrowError( std::invalid_argument( fileName ) );
+        }
+
+        m_pTree = new TTree( "SherpaME", "SherpaME" );   // owned by current directory
+        if (m_pTree->IsZombie())
+            ThrowError("Failed to construct output tree.");
+
+        m_pTree->SetDirectory( m_upFile.get() );    // attach to output file, output file now owns tree and will call delete
+        m_pTree->SetAutoSave(0);                    // disable autosave
 
-            particles.push_back( part.pdg );
-            momenta  .push_back( P_part   );
+        if (bPointsTree)
+        {
+            m_upPointsEvent.reset( new MEPointsRootEvent );
+            m_upPointsEvent->SetOutputTree( m_pTree );
+            m_upPointsEvent->npoint = static_cast<Int_t>(nPoints);
+        }
+        else
+        {
+            m_event.SetOutputTree( m_pTree, bError );
         }
     }
 
-    // get the matrix element for the event
+    void Fill( int32_t id, const double * pME, uint64_t entry, double error = 0 )    // error: me_err of the single point tree
+    {
+        if (m_upStream)
+        {
+            m_upStream->Write( id, pME );
+            return;
+        }
+
+        if (m_upPointsEvent)
+        {
+            m_upPointsEvent->id = id;
+            std::copy_n( pME, m_nPoints, m_upPointsEvent->me );
+        }
+        else
+        {
+            m_event.id     = id;
+            m_event.me     = *pME;
+            m_event.me_err = error;
+        }
 
-    double me = GetEventME( inputEvent.input.size(), particles, momenta );
+        AllocationCountPause pause;     // root allocates its baskets as the tree grows
 
-    outputEvent.id = eventId;
-    outputEvent.me = me;
+        if (m_pTree->Fill() < 0)
+            ThrowError( "Fill failed on entry " + std::to_string(entry) );
+    }
 
-    return true;
-}
+    void Close()    // after the last event; on an error the output is left incomplete
+    {
+        if (m_upStream)
+            m_upStream->Finish();
+
+        if (m_upFile)
+        {
+            m_upFile->Write( 0, TFile::kOverwrite );
+            m_upFile->Close();
+        }
+    }
+
+private:
+    size_t                              m_nPoints;
+    std::unique_ptr<TFile>              m_upFile;
+    TTree *                             m_pTree     = nullptr;
+    MERootEvent                         m_event;
+    std::unique_ptr<MEPointsRootEvent>  m_upPointsEvent;
+    std::unique_ptr<MEStreamWriter>     m_upStream;
+};
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-double SherpaMEProgram::GetEventME( size_t nInParticles, const std::vector<int> & particleCodes, const ATOOLS::Vec4D_Vector & particleMomenta )
+// Each non-empty line of a points file lists the Sherpa arguments of one parameter point,
+// separated by tabs. Lines starting with '#' are comments.
+
+static std::vector<std::vector<std::string>> ReadPointsFile( const std::string & fileName )
 {
-    if (!nInParticles || (nInParticles > particleCodes.size()))
-        ThrowError( std::invalid_argument( "GetEventME: invalid number of input particles " + std::to_string(nInParticles) ) );
-    
-    if (particleCodes.size() != particleMomenta.size())
-        ThrowError( std::invalid_argument( "GetEventME: mismatch in number of particle codes and momenta" ) );
-    
-    SherpaMECalculator meCalc( m_upSherpa.get() );
+    std::ifstream file( fileName );
+    if (!file)
+        ThrowError( "Failed to open points file (" + fileName + ")." );
 
-    for (size_t i = 0; i < particleCodes.size(); ++i)
+    std::vector<std::vector<std::string>> points;
+
+    std::string line;
+    while (std::getline( file, line ))
     {
-        if (i < nInParticles)
-            meCalc.AddInFlav( particleCodes[i] );
-        else
-            meCalc.AddOutFlav( particleCodes[i] );
+        if (line.empty() || (line[0] == '#'))
+            continue;
+
+        std::vector<std::string> args;
+
+        size_t start = 0;
+        for (size_t tab; (tab = line.find( '\t', start )) != std::string::npos; start = tab + 1)
+            args.push_back( line.substr( start, tab - start ) );
+        args.push_back( line.substr( start ) );
+
+        args.erase( std::remove( args.begin(), args.end(), std::string() ), args.end() );
+
+        points.push_back( std::move(args) );
     }
 
+    if (points.empty())
+        ThrowError( "No parameter points in points file (" + fileName + ")." );
+
+    if (points.size() > MEPointsRootEvent::max_npoint)
+        ThrowError( "Too many parameter points in points file (" + fileName + "). Maximum is " + std::to_string(MEPointsRootEvent::max_npoint) + "." );
+
+    return points;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// An unnamed temporary file in TMPDIR (or /tmp), removed when its last descriptor is closed.
+
+static int CreateSpillFile()
+{
+    const char * pTempDir = getenv( "TMPDIR" );
+
+    std::string path = std::string( (pTempDir && *pTempDir) ? pTempDir : "/tmp" ) + "/SherpaME_spill_XXXXXX";
+
+    int fd = mkstemp( &path[0] );
+    if (fd < 0)
+        ThrowError( std::system_error( errno, std::generic_category(), "Failed to create spill file (" + path + ")." ) );
+
+    unlink( path.c_str() );
+    return fd;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Runs the body of a forked child process and ends the process with its exit status, without
+// returning into the caller or running the exit handlers of the state inherited from the parent.
+
+[[noreturn]] static void RunChildProcess( const std::function<void()> & body ) throw()
+{
+    int result = EXIT_SUCCESS;
     try
     {
-        meCalc.Initialize();
+        body();
     }
     catch (const ATOOLS::Exception & error)
     {
-        // TODO: remove this catch, refactor Initialize to return a bool
-    
-        LogMsgError( "Sherpa exception caught: \"%hs\" in %hs::%hs",
-            FMT_HS(error.Info().c_str()), FMT_HS(error.Class().c_str()), FMT_HS(error.Method().c_str()) );
-        
-        LogMsgInfo( "Sherpa process name: \"%hs\"", FMT_HS(meCalc.Name().c_str()) );
-        
-        const ATOOLS::Cluster_Amplitude * pAmp = meCalc.GetAmp();
-        if (!pAmp)
-            LogMsgInfo("Sherpa process cluster amplitude: null");
-        else
-        {
-            //const ATOOLS::ClusterLeg_Vector & legs = pAmp->Legs();
-            //int bob = 5;
-        }
+        LogMsgError( "Sherpa Exception: %hs\n\t[Source %hs::%hs]",
+                    FMT_HS(error.Info().c_str()), FMT_HS(error.Class().c_str()), FMT_HS(error.Method().c_str()) );
+        result = EXIT_FAILURE;
+    }
+    catch (const std::exception & error)
+    {
+        LogMsgError( "Exception: %hs", FMT_HS(error.what()) );
+        result = EXIT_FAILURE;
+    }
+    catch (...)
+    {
+        LogMsgError( "Unknown Exception!" );
+        result = EXIT_FAILURE;
+    }
 
-        throw;
+    fflush( stdout );
+    fflush( stderr );
+    _exit( result );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Reply to a server request that failed before its OK (see MEServer.h).
+
+static void ReplyError( int fd, std::string errorMsg )
+{
+    LogMsgError( "Request failed: %hs", FMT_HS(errorMsg.c_str()) );
+
+    std::replace( errorMsg.begin(), errorMsg.end(), '\t', ' ' );
+    std::replace( errorMsg.begin(), errorMsg.end(), '\n', ' ' );
+
+    try
+    {
+        MEServerWriteLine( fd, "ERROR\t" + errorMsg );
+    }
+    catch (const std::exception &)
+    {
+        // client already gone
     }
+}
 
-    meCalc.SetMomenta( particleMomenta );
-    
-    double value = meCalc.CSMatrixElement();
-    return value;
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// class SherpaMEProgram
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+SherpaMEProgram::SherpaMEProgram()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+SherpaMEProgram::~SherpaMEProgram() throw()
+{
+    try
+    {
+        m_upEvaluator.reset();
+        m_upStore.reset();
+        m_upSherpa.reset();
+    }
+    catch (...)
+    {
+        LogMsgError( "Unexpected exception while terminating Sherpa framework." );
+    }
+
+    // finalize MPI (required if sherpa was compiled with --enable-mpi configure option)
+    if (m_bMPIInitialized)
+        MPI::Finalize();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Number of processes of the MPI job this process was started in, from the environment of the
+// common launchers, before MPI is initialized (1 if not started by one).
+
+static int MPILaunchSize()
+{
+    for (const char * name : { "OMPI_COMM_WORLD_SIZE", "PMI_SIZE", "PMIX_SIZE", "MV2_COMM_WORLD_SIZE" })
+    {
+        const char * value = getenv( name );
+        if (value && (atoi( value ) > 0))
+            return atoi( value );
+    }
+
+    return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Rank of this process in the MPI job it was started in, from the same environment (0 if not
+// started by one).
+
+static int MPILaunchRank()
+{
+    for (const char * name : { "OMPI_COMM_WORLD_RANK", "PMI_RANK", "PMIX_RANK", "MV2_COMM_WORLD_RANK" })
+    {
+        const char * value = getenv( name );
+        if (value && *value && (atoi( value ) >= 0))
+            return atoi( value );
+    }
+
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// MPI is initialized at the start of a run rather than in the constructor, so that a run with
+// worker processes or a server, which fork, never initializes it: MPI does not support forking an
+// initialized process. These modes therefore exclude more than one MPI rank, and a Sherpa built
+// with MPI support. Multi-point mode forks its point processes before it initializes MPI to
+// gather the results (see RunPoints), so it shards the events by the rank given by the launcher.
+
+void SherpaMEProgram::InitializeMPI( const RunParameters & param )
+{
+    if ((param.nWorkers > 1) || !param.serverSocketPath.empty())
+    {
+        const char * mode = (param.nWorkers > 1) ? "Option --workers" : "SherpaME server";
+
+    #ifdef USING__MPI
+        ThrowError( std::string(mode) + " cannot be used with a Sherpa built with MPI support." );
+    #endif
+
+        if (MPILaunchSize() > 1)
+            ThrowError( std::string(mode) + " cannot be used in an MPI job with more than one rank." );
+        return;
+    }
+
+    if (!param.pointsFileName.empty())
+    {
+    #ifdef USING__MPI
+        ThrowError( "Option --points cannot be used with a Sherpa built with MPI support." );
+    #endif
+
+        m_mpiRank = MPILaunchRank();
+        m_mpiSize = MPILaunchSize();
+
+        if (m_mpiRank >= m_mpiSize)
+            ThrowError( "MPI rank " + std::to_string(m_mpiRank) + " is not below the MPI job size " + std::to_string(m_mpiSize) + "." );
+        return;
+    }
+
+    StartMPI();
+
+    // the soak check expects flat memory, but rank 0 gathers the results of the other ranks
+    if (param.bSoak && (m_mpiSize > 1))
+        ThrowError( "Option --soak cannot be used with more than one MPI rank." );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void SherpaMEProgram::StartMPI()
+{
+    // initialize MPI (required if sherpa was compiled with --enable-mpi configure option)
+    MPI::Init();
+    m_bMPIInitialized = true;
+
+    m_mpiRank = MPI::COMM_WORLD.Get_rank();
+    m_mpiSize = MPI::COMM_WORLD.Get_size();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+int SherpaMEProgram::ParseCommandLine( int argc, const char * argv[], RunParameters & param )
+{
+    param = RunParameters();  // clear all values in case of error
+
+    int a = 3;
+
+    if (argc < 3)
+        goto USAGE;
+    
+    param.argv.push_back( argv[0] );
+
+    if (strcmp( argv[1], "--server" ) == 0)
+    {
+        // server mode: the input files and parameter points are given by the requests
+        param.serverSocketPath = argv[2];
+    }
+    else
+    {
+        param.inputRootFileName  = argv[1];
+        param.outputRootFileName = argv[2];
+
+        if (param.inputRootFileName.empty() || param.outputRootFileName.empty())
+            goto USAGE;
+
+        if (param.inputRootFileName == param.outputRootFileName)
+        {
+            LogMsgError( "Output root file cannot be the same as the input root file." );
+            return -1;
+        }
+    }
+
+    // options precede the sherpa arguments
+
+    for ( ; (a < argc) && (strncmp( argv[a], "--", 2 ) == 0); ++a)
+    {
+        if ((strcmp( argv[a], "--points" ) == 0) && (a + 1 < argc))
+        {
+            param.pointsFileName = argv[++a];
+        }
+        else if ((strcmp( argv[a], "--me-store" ) == 0) && (a + 1 < argc))
+        {
+            param.meStorePath = argv[++a];
+        }
+        else if ((strcmp( argv[a], "--window" ) == 0) && (a + 1 < argc))
+        {
+            long window = atol( argv[++a] );
+            if (window < 1)
+            {
+                LogMsgError( "Invalid event window %hs.", FMT_HS(argv[a]) );
+                return -1;
+            }
+            param.eventWindow = static_cast<size_t>(window);
+        }
+        else if ((strcmp( argv[a], "--workers" ) == 0) && (a + 1 < argc))
+        {
+            long workers = atol( argv[++a] );
+            if (workers < 1)
+            {
+                LogMsgError( "Invalid number of workers %hs.", FMT_HS(argv[a]) );
+                return -1;
+            }
+            param.nWorkers = static_cast<size_t>(workers);
+        }
+        else if (strcmp( argv[a], "--soak" ) == 0)
+        {
+            param.bSoak = true;
+        }
+        else if ((strcmp( argv[a], "--dedup" ) == 0) && (a + 1 < argc))
+        {
+            long entries = atol( argv[++a] );
+            if (entries < 0)
+            {
+                LogMsgError( "Invalid dedup cache size %hs.", FMT_HS(argv[a]) );
+                return -1;
+            }
+            param.dedupEntries = static_cast<size_t>(entries);
+        }
+        else if ((strcmp( argv[a], "--color-sampling" ) == 0) && (a + 1 < argc))
+        {
+            param.colorPrecision = atof( argv[++a] );
+            if (!(param.colorPrecision > 0))
+            {
+                LogMsgError( "Invalid colour sampling precision %hs.", FMT_HS(argv[a]) );
+                return -1;
+            }
+        }
+        else
+        {
+            LogMsgError( "Unknown or incomplete option %hs.", FMT_HS(argv[a]) );
+            goto USAGE;
+        }
+    }
+
+    if (!param.serverSocketPath.empty() && !param.pointsFileName.empty())
+    {
+        LogMsgError( "Option --points cannot be used in server mode." );
+        return -1;
+    }
+
+    if ((param.nWorkers > 1) && (!param.serverSocketPath.empty() || !param.pointsFileName.empty()))
+    {
+        LogMsgError( "Option --workers cannot be used with --points or in server mode." );
+        return -1;
+    }
+
+    if ((param.colorPrecision > 0) && !param.pointsFileName.empty())
+    {
+        LogMsgError( "Option --color-sampling cannot be used with --points." );
+        return -1;
+    }
+
+    // the soak check expects flat memory, but the result buffers of these modes grow with the input by design
+    // (more than one MPI rank is rejected once MPI is initialized)
+    if (param.bSoak && (!param.serverSocketPath.empty() || !param.pointsFileName.empty() || !param.meStorePath.empty()))
+    {
+        LogMsgError( "Option --soak cannot be used with --points, --me-store or in server mode." );
+        return -1;
+    }
+    
+    for ( ; a < argc; ++a)
+        param.argv.push_back( argv[a] );
+
+    return 0;
+
+ USAGE:
+    LogMsgInfo("Usage: SherpaME input_root_file (output_root_file | fd:<n>) [--points points_file] [--me-store directory]");
+    LogMsgInfo("                [--window events] [--workers n] [--dedup entries] [--color-sampling relative_precision] [--soak]");
+    LogMsgInfo("                <sherpa_arguments ...>");
+    LogMsgInfo("       SherpaME --server socket_path [--me-store directory] [--dedup entries] <sherpa_arguments ...>");
+    return -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void SherpaMEProgram::InitializeSherpa( const std::vector<const char *> & argv, const StringVector & extraArgs )
+{
+    // Sherpa keeps its run state in globals, so rather than relying on its teardown it is only
+    // initialized once per process; the modes with several parameter points fork a process per point
+    if (m_upSherpa->GetInitHandler())
+        ThrowError( "Sherpa is already initialized in this process." );
+
+    std::vector<const char *> runArgv(argv);
+
+  //runArgv.push_back( "OUTPUT=15" );
+    runArgv.push_back( "INIT_ONLY=2"   );   // prevent Sherpa from starting the cross section integration
+    runArgv.push_back( "EVENT_OUTPUT=" );   // prevent Sherpa from overwriting any event file specified in the dat file
+
+    for (const std::string & arg : extraArgs)
+        runArgv.push_back( arg.c_str() );
+
+    if (!m_upSherpa->InitializeTheRun( static_cast<int>(runArgv.size()), const_cast<char **>(runArgv.data()) ))
+        ThrowError( "Failed to initialize Sherpa framework. Check Run.dat file." );
+
+    m_upEvaluator.reset( new SherpaMEEvaluator( m_upSherpa.get() ) );
+
+    if (m_colorPrecision > 0)
+        m_upEvaluator->SetColorSampling( m_colorPrecision );
+
+    m_upEvaluator->SetDuplicateCache( m_dedupEntries );
+
+    if (m_upStore)
+    {
+        StringVector storeArgs( argv.begin() + 1, argv.end() );     // skip program name
+        storeArgs.insert( storeArgs.end(), extraArgs.begin(), extraArgs.end() );
+
+        m_upEvaluator->AttachStore( m_upStore.get(), storeArgs );
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void SherpaMEProgram::LogDuplicates() const
+{
+    if (!m_upEvaluator || (m_upEvaluator->NCacheLookups() == 0))
+        return;
+
+    uint64_t nHits    = m_upEvaluator->NCacheHits();
+    uint64_t nLookups = m_upEvaluator->NCacheLookups();
+
+    LogMsgInfo( "Duplicate events: %llu of %llu (%.1f%%)", FMT_LLU(nHits), FMT_LLU(nLookups),
+                FMT_F(100.0 * static_cast<double>(nHits) / static_cast<double>(nLookups)) );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+int SherpaMEProgram::Run( const RunParameters & param )
+{
+    try
+    {
+        time_t timeStartRun = time(nullptr);
+
+        InitializeMPI( param );
+
+        m_upSherpa.reset( new SHERPA::Sherpa );
+
+        if (!param.meStorePath.empty())
+        {
+            LogMsgInfo( "ME store   : %hs", FMT_HS(param.meStorePath.c_str()) );
+            m_upStore.reset( new MatrixElementStore( param.meStorePath ) );
+        }
+
+        m_colorPrecision = param.colorPrecision;
+        if (m_colorPrecision > 0)
+            LogMsgInfo( "Colour sampling to relative precision %E", FMT_F(m_colorPrecision) );
+
+        m_dedupEntries = param.dedupEntries;
+        m_bSoak        = param.bSoak;
+
+        if (!param.serverSocketPath.empty())
+            return RunServer( param );
+
+        if (!param.pointsFileName.empty())
+            return RunPoints( param, timeStartRun );
+
+        // initialize sherpa
+
+        InitializeSherpa( param.argv );
+
+        // open input file
+
+        LogMsgInfo( "Input file : %hs", FMT_HS(param.inputRootFileName.c_str()) );
+        std::unique_ptr<EventFileInterface> upInputFile = OpenInputFile( param.inputRootFileName );
+        EventFileInterface &                inputFile   = *upInputFile;
+
+        // with several MPI ranks each rank evaluates its own share of the events,
+        // which rank 0 gathers and writes in entry order; worker processes (never with MPI) split the events
+        // read by this process
+
+        EventShard shard( inputFile.Count(), m_mpiRank, m_mpiSize );
+
+        if (m_mpiSize > 1)
+            LogMsgInfo( "MPI rank %i of %i", FMT_I(m_mpiRank), FMT_I(m_mpiSize) );
+
+        // create output file and tree
+
+        std::unique_ptr<MEOutput> upOutput;
+
+        if (m_mpiRank == 0)
+            upOutput.reset( new MEOutput( param.outputRootFileName, 1, false, m_colorPrecision > 0 ) );
+
+        std::vector<uint64_t>       shardEntries;   // results held for rank 0 when sharded
+        std::vector<int32_t>        shardIds;
+        std::vector<double>         shardME;
+        std::vector<double>         shardError;
+        
+        // process each input event
+
+        uint64_t    iEvent          = 1;
+        uint64_t    nEvents         = inputFile.Count();
+        uint64_t    logFrequency    = 1;
+        uint32_t    logCount        = 0;
+
+        if (nEvents)
+            LogMsgInfo( "\nGetting matrix elements for %llu events ...", FMT_LLU(nEvents) );
+        else
+            LogMsgInfo( "\nGetting matrix elements for events ..." );
+
+        time_t timeStartProcess = time(nullptr);
+
+        auto onResult = [&]( uint64_t entry, int32_t eventId, double me, double error )
+        {
+            if (iEvent % logFrequency == 0)
+            {
+                if (++logCount == 10)
+                {
+                    logFrequency *= 10;
+                    logCount      = 1;
+                }
+
+                if (m_colorPrecision > 0)
+                    LogMsgInfo( "Event %llu (id %i): ME = %E +- %E", FMT_LLU(iEvent), FMT_I(eventId), FMT_F(me), FMT_F(error) );
+                else
+                    LogMsgInfo( "Event %llu (id %i): ME = %E", FMT_LLU(iEvent), FMT_I(eventId), FMT_F(me) );
+            }
+
+            ++iEvent;
+
+            if (m_mpiSize > 1)
+            {
+                AllocationCountPause pause;     // the rank's results grow by design
+
+                shardEntries.push_back( entry   );
+                shardIds    .push_back( eventId );
+                shardME     .push_back( me      );
+                shardError  .push_back( error   );
+                return;
+            }
+
+            upOutput->Fill( eventId, &me, entry, error );
+        };
+
+        if (param.nWorkers > 1)
+        {
+            RunWorkers( param, inputFile, shard, onResult );
+        }
+        else
+        {
+            EventFileEvent::UniquePtr upInputEvent = inputFile.AllocateEvent();
+
+            EvaluateShard( [&]( uint64_t & entry, int32_t & eventId, EventFileVertex & vertex )
+                           {
+                               return shard.ReadVertex( inputFile, *upInputEvent, entry, eventId, vertex );
+                           },
+                           param.eventWindow, onResult );
+        }
+
+        if (m_mpiSize > 1)
+        {
+            GatherToRoot( shardEntries );
+            GatherToRoot( shardIds     );
+            GatherToRoot( shardME      );
+            GatherToRoot( shardError   );
+
+            if (upOutput)
+            {
+                for (size_t i : EntryOrder( shardEntries ))
+                    upOutput->Fill( shardIds[i], &shardME[i], shardEntries[i], shardError[i] );
+            }
+        }
+
+        if (m_upStore && (param.nWorkers <= 1))     // the workers report their own counts
+        {
+            m_upStore->Flush();
+            LogMsgInfo( "ME store: %llu found, %llu added, %llu hash collisions.", FMT_LLU(m_upStore->NFound()), FMT_LLU(m_upStore->NAdded()),
+                        FMT_LLU(m_upStore->NCollisions()) );
+        }
+
+        if (param.nWorkers <= 1)
+            LogDuplicates();
+
+        // write and close the output file (not really necessary as would be done in destructor)
+        
+        if (upOutput)
+            upOutput->Close();
+
+        time_t timeStopProcess = time(nullptr);
+
+        LogMsgInfo( "%llu events completed. (%u seconds)", FMT_LLU(iEvent-1), FMT_U(timeStopProcess - timeStartProcess) );
+        LogMsgInfo( "Done. (%u seconds)", FMT_U(timeStopProcess - timeStartRun) );
+
+        return EXIT_SUCCESS;
+    }
+    catch (const ATOOLS::Exception & error)
+    {
+        LogMsgError( "Sherpa Exception: %hs\n\t[Source %hs::%hs]",
+                    FMT_HS(error.Info().c_str()), FMT_HS(error.Class().c_str()), FMT_HS(error.Method().c_str()) );
+    }
+    catch (const std::exception & error)
+    {
+        if (m_mpiSize == 1)
+            throw;  // reported by main
+
+        LogMsgError( "Exception: %hs", FMT_HS(error.what()) );
+    }
+
+    if (m_mpiSize > 1)
+    {
+        // the other ranks would otherwise wait forever to exchange results with this one
+        LogMsgError( "Aborting MPI job from rank %i.", FMT_I(m_mpiRank) );
+        if (!m_bMPIInitialized)
+            MPI::Init();    // multi-point mode fails before it initializes MPI
+        MPI::COMM_WORLD.Abort( EXIT_FAILURE );
+    }
+
+    return EXIT_FAILURE;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The input interleaves the subprocesses, so the events are read in windows, evaluated in batches
+// per subprocess and passed on in input order. Reading and passing on the results run on their
+// own threads (see EventPipeline); only the evaluation uses Sherpa.
+
+void SherpaMEProgram::EvaluateShard( const VertexSource & onRead, size_t windowSize, const ResultHandler & onResult )
+{
+    const size_t PipelineDepth  = 4;    // windows in flight
+
+    EventPipeline               pipeline( PipelineDepth, windowSize );
+    MemoryMonitor               monitor;
+
+    // each stage runs on its own thread and counts its own allocations (debug builds); those of
+    // Sherpa, the file formats, root and the ME store are not counted (see AllocationCountPause)
+    StageAllocations            readerAllocs( "Reader" );
+    StageAllocations            evaluatorAllocs( "Evaluator" );
+    StageAllocations            writerAllocs( "Writer" );
+
+    pipeline.Run(
+        [&]( EventPipeline::Window & window )
+        {
+            readerAllocs.Begin();
+
+            window.count = 0;
+            while (window.count < windowSize)
+            {
+                EventPipeline::BlockEvent & event = window.events[window.count];
+                if (!onRead( event.entry, event.eventId, event.vertex ))
+                    break;
+                ++window.count;
+            }
+
+            if (window.count == 0)
+                return false;
+
+            readerAllocs.End( window.count );
+            return true;
+        },
+        [&, this]( EventPipeline::Window & window )
+        {
+            evaluatorAllocs.Begin();
+
+            m_upEvaluator->EventMEs( window.vertices.data(), window.count, window.me.data(), window.error.data() );
+
+            evaluatorAllocs.End( window.count );
+            return true;
+        },
+        [&, this]( EventPipeline::Window & window )
+        {
+            writerAllocs.Begin();
+
+            for (size_t i = 0; i < window.count; ++i)
+                onResult( window.events[i].entry, window.events[i].eventId, window.me[i], window.error[i] );
+
+            if (m_bSoak)
+                monitor.Count( window.count );
+
+            writerAllocs.End( window.count );
+            return true;
+        } );
+
+    readerAllocs.Log();
+    evaluatorAllocs.Log();
+    writerAllocs.Log();
+
+    if (m_bSoak)
+        monitor.Check();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Sherpa keeps its state in globals, so the events are shared among forked worker processes
+// instead of threads. Each worker inherits the initialized Sherpa copy-on-write. This process
+// reads the input once and deals the signal vertices round-robin to the workers through their
+// input pipes (see VertexStream.h); each worker streams (id, me, error) records back through a
+// result pipe. Worker w evaluates events w, w + n, w + 2n, ... so taking one record from each
+// worker in turn restores the input order.
+// The events dealt but not yet passed on are limited to a few windows per worker: enough for each
+// worker to fill its windows, while a worker that runs ahead waits for input instead of growing
+// the queues of this process.
+
+void SherpaMEProgram::RunWorkers( const RunParameters & param, EventFileInterface & inputFile, EventShard & shard, const ResultHandler & onResult )
+{
+    struct Worker
+    {
+        pid_t                   pid         = -1;
+        int                     inputFd     = -1;   // write end of the input pipe, non-blocking
+        int                     resultFd    = -1;   // read end of the result pipe
+        std::vector<char>       input;              // vertex records not yet written
+        size_t                  inputOffset = 0;
+        MEStreamReader          reader;
+        std::deque<int32_t>     ids;
+        std::deque<double>      me;                 // me, error pairs
+    };
+
+    const size_t    nWorkers    = param.nWorkers;
+    const uint64_t  maxInFlight = 4 * param.eventWindow * nWorkers;
+
+    LogMsgInfo( "Workers    : %u", FMT_U(nWorkers) );
+
+    std::vector<Worker> workers( nWorkers );
+
+    auto closeFd = []( int & fd )
+    {
+        if (fd >= 0)
+            close( fd );
+        fd = -1;
+    };
+
+    auto stopWorkers = [&workers, &closeFd]()
+    {
+        for (Worker & worker : workers)
+        {
+            closeFd( worker.inputFd  );
+            closeFd( worker.resultFd );
+
+            if (worker.pid > 0)
+            {
+                kill( worker.pid, SIGTERM );
+                waitpid( worker.pid, nullptr, 0 );
+            }
+            worker.pid = -1;
+        }
+    };
+
+    signal( SIGPIPE, SIG_IGN );     // a failed worker is reported by its result stream, not by stopping this process
+
+    try
+    {
+        fflush( stdout );   // not to be repeated by the children
+        fflush( stderr );
+
+        for (size_t w = 0; w < nWorkers; ++w)
+        {
+            int inputFds[2];
+            int resultFds[2];
+            if (pipe( inputFds ) != 0)
+                ThrowError( std::system_error( errno, std::generic_category(), "Failed to create worker pipe." ) );
+            if (pipe( resultFds ) != 0)
+            {
+                int error = errno;
+                close( inputFds[0] );
+                close( inputFds[1] );
+                ThrowError( std::system_error( error, std::generic_category(), "Failed to create worker pipe." ) );
+            }
+
+            pid_t pid = fork();
+            if (pid < 0)
+            {
+                int error = errno;
+                for (int fd : { inputFds[0], inputFds[1], resultFds[0], resultFds[1] })
+                    close( fd );
+                ThrowError( std::system_error( error, std::generic_category(), "Failed to fork worker process." ) );
+            }
+
+            if (pid == 0)
+            {
+                // worker process
+                RunChildProcess( [&, this]()
+                {
+                    close( inputFds[1] );
+                    close( resultFds[0] );
+                    for (size_t other = 0; other < w; ++other)
+                    {
+                        closeFd( workers[other].inputFd  );
+                        closeFd( workers[other].resultFd );
+                    }
+
+                    VertexStreamReader  input( inputFds[0] );
+                    MEStreamWriter      writer( resultFds[1], 2 );
+                    uint64_t            nEvaluated = 0;
+
+                    EvaluateShard( [&input]( uint64_t & entry, int32_t & eventId, EventFileVertex & vertex )
+                                   {
+                                       return input.Read( entry, eventId, vertex );
+                                   },
+                                   param.eventWindow,
+                                   [&writer, &nEvaluated]( uint64_t, int32_t eventId, double me, double error )
+                                   {
+                                       const double record[2] = { me, error };
+                                       writer.Write( eventId, record );
+                                       ++nEvaluated;
+                                   } );
+
+                    writer.Finish();
+
+                    LogMsgInfo( "Worker %u: %llu events evaluated.", FMT_U(w + 1), FMT_LLU(nEvaluated) );
+
+                    if (m_upStore)
+                    {
+                        m_upStore->Flush();
+                        LogMsgInfo( "Worker %u: ME store: %llu found, %llu added, %llu hash collisions.", FMT_U(w + 1),
+                                    FMT_LLU(m_upStore->NFound()), FMT_LLU(m_upStore->NAdded()), FMT_LLU(m_upStore->NCollisions()) );
+                    }
+
+                    LogDuplicates();
+                } );
+            }
+
+            close( inputFds[0] );
+            close( resultFds[1] );
+
+            workers[w].pid      = pid;
+            workers[w].inputFd  = inputFds[1];
+            workers[w].resultFd = resultFds[0];
+
+            if (fcntl( inputFds[1], F_SETFL, fcntl( inputFds[1], F_GETFL ) | O_NONBLOCK ) != 0)
+                ThrowError( std::system_error( errno, std::generic_category(), "Failed to configure worker pipe." ) );
+        }
+
+        // deal the input events, write them to the workers as their pipes take them, and pass on
+        // the results in input order
+
+        EventFileEvent::UniquePtr   upInputEvent = inputFile.AllocateEvent();
+        EventFileVertex             vertex;
+        uint64_t                    entry       = 0;
+        int32_t                     eventId     = 0;
+        bool                        bInputDone  = false;
+        uint64_t                    nDealt      = 0;
+        uint64_t                    nextIndex   = 0;
+        size_t                      nOpen       = nWorkers;
+        std::vector<pollfd>         pollFds;
+        std::vector<size_t>         pollWorkers;
+        char                        buffer[1 << 16];
+
+        while (nOpen)
+        {
+            while (!bInputDone && (nDealt - nextIndex < maxInFlight))
+            {
+                if (!shard.ReadVertex( inputFile, *upInputEvent, entry, eventId, vertex ))
+                {
+                    bInputDone = true;
+                    break;
+                }
+
+                VertexStreamWriter::Encode( workers[nDealt % nWorkers].input, entry, eventId, vertex );
+                ++nDealt;
+            }
+
+            pollFds.clear();
+            pollWorkers.clear();
+
+            for (size_t w = 0; w < nWorkers; ++w)
+            {
+                Worker & worker = workers[w];
+
+                if ((worker.inputFd >= 0) && (worker.inputOffset == worker.input.size()))
+                {
+                    worker.input.clear();
+                    worker.inputOffset = 0;
+
+                    if (bInputDone)
+                        closeFd( worker.inputFd );     // the end of the worker's events
+                }
+
+                if ((worker.inputFd >= 0) && !worker.input.empty())     // only while it has data to take
+                {
+                    pollFds.push_back( pollfd{ worker.inputFd, POLLOUT, 0 } );
+                    pollWorkers.push_back( w );
+                }
+
+                if (worker.resultFd >= 0)
+                {
+                    pollFds.push_back( pollfd{ worker.resultFd, POLLIN, 0 } );
+                    pollWorkers.push_back( w );
+                }
+            }
+
+            if (poll( pollFds.data(), pollFds.size(), -1 ) < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                ThrowError( std::system_error( errno, std::generic_category(), "Failed waiting for workers." ) );
+            }
+
+            for (size_t p = 0; p < pollFds.size(); ++p)
+            {
+                const pollfd & ready  = pollFds[p];
+                Worker &       worker = workers[ pollWorkers[p] ];
+
+                if (ready.revents == 0)
+                    continue;
+
+                if (ready.fd == worker.inputFd)
+                {
+                    ssize_t nWritten = write( worker.inputFd, worker.input.data() + worker.inputOffset, worker.input.size() - worker.inputOffset );
+                    if (nWritten < 0)
+                    {
+                        if ((errno == EINTR) || (errno == EAGAIN) || (errno == EWOULDBLOCK))
+                            continue;
+                        if (errno != EPIPE)
+                            ThrowError( std::system_error( errno, std::generic_category(), "Failed to write worker input." ) );
+
+                        closeFd( worker.inputFd );     // the worker has stopped; its result stream reports it
+                        worker.input.clear();
+                        worker.inputOffset = 0;
+                        continue;
+                    }
+
+                    worker.inputOffset += static_cast<size_t>(nWritten);
+                    continue;
+                }
+
+                ssize_t nRead = read( worker.resultFd, buffer, sizeof(buffer) );
+                if (nRead < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    ThrowError( std::system_error( errno, std::generic_category(), "Failed to read worker results." ) );
+                }
+
+                if (nRead == 0)
+                {
+                    closeFd( worker.resultFd );
+                    --nOpen;
+                    continue;
+                }
+
+                worker.reader.Parse( buffer, static_cast<size_t>(nRead), [&worker]( int32_t id, const double * pME, size_t )
+                {
+                    worker.ids.push_back( id );
+                    worker.me.push_back( pME[0] );
+                    worker.me.push_back( pME[1] );
+                } );
+            }
+
+            for (;;)
+            {
+                Worker & worker = workers[nextIndex % nWorkers];
+                if (worker.ids.empty())
+                {
+                    // the worker due next has ended before all its events were evaluated
+                    if ((worker.resultFd < 0) && (nextIndex < nDealt))
+                        ThrowError( "Worker process " + std::to_string(nextIndex % nWorkers + 1) + " ended early." );
+                    break;
+                }
+
+                onResult( shard.Entry( nextIndex ), worker.ids.front(), worker.me[0], worker.me[1] );
+
+                worker.ids.pop_front();
+                worker.me.pop_front();
+                worker.me.pop_front();
+                ++nextIndex;
+            }
+        }
+
+        // all streams are closed; check the workers completed
+
+        size_t nFailed = 0;
+        for (Worker & worker : workers)
+        {
+            int status = 0;
+            while ((waitpid( worker.pid, &status, 0 ) < 0) && (errno == EINTR))
+                continue;
+            worker.pid = -1;
+
+            if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0) || !worker.reader.Complete() || !worker.ids.empty())
+                ++nFailed;
+        }
+
+        if (nFailed)
+            ThrowError( std::to_string(nFailed) + " of " + std::to_string(nWorkers) + " worker processes failed." );
+
+        if (!bInputDone || (nextIndex != nDealt))
+            ThrowError( "Worker processes ended before all events were evaluated." );
+    }
+    catch (...)
+    {
+        stopWorkers();
+        throw;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Multi-point mode: evaluate every event at each parameter point, with a single output row holding
+// all matrix elements of an event. Sherpa fixes the model couplings at initialization and is only
+// initialized once per process, so each point is evaluated by a point process of its own, one after
+// the other, which streams its matrix elements back in event order (see MEStream.h).
+// The input is parsed only once: the first point process spills the signal vertices of the rank's
+// events to a temporary file of compact records (see VertexStream.h) while it evaluates them, and
+// the other point processes replay the file. Only the matrix elements of the rank's events are
+// held in memory until the output is written. The point processes are forked before MPI is
+// initialized, which is only done to gather the results of the ranks.
+
+int SherpaMEProgram::RunPoints( const RunParameters & param, time_t timeStartRun )
+{
+    const std::vector<StringVector> points = ReadPointsFile( param.pointsFileName );
+
+    LogMsgInfo( "Points file: %hs (%u points)", FMT_HS(param.pointsFileName.c_str()), FMT_U(points.size()) );
+    LogMsgInfo( "Input file : %hs", FMT_HS(param.inputRootFileName.c_str()) );
+
+    const size_t nPoints = points.size();
+
+    // with several MPI ranks each rank evaluates its own share of the events; the point processes
+    // return them in the order of the share, so their entries follow from the shard
+
+    const EventShard shard( OpenInputFile( param.inputRootFileName )->Count(), m_mpiRank, m_mpiSize );
+
+    if (m_mpiSize > 1)
+        LogMsgInfo( "MPI rank %i of %i", FMT_I(m_mpiRank), FMT_I(m_mpiSize) );
+
+    LogMsgInfo( "\nGetting matrix elements at %u points ...", FMT_U(nPoints) );
+
+    time_t timeStartProcess = time(nullptr);
+
+    // evaluate each point; the results are stored event major
+
+    std::vector<uint64_t> entries;
+    std::vector<int32_t>  ids;
+    std::vector<double>   me;
+
+    const int spillFd = (nPoints > 1) ? CreateSpillFile() : -1;    // the vertices of the rank's events, shared with the point processes
+    pid_t     pid     = -1;
+    int       meFd    = -1;
+
+    try
+    {
+        for (size_t point = 0; point < nPoints; ++point)
+        {
+            time_t timeStartPoint = time(nullptr);
+
+            int fds[2];
+            if (pipe( fds ) != 0)
+                ThrowError( std::system_error( errno, std::generic_category(), "Failed to create point process pipe." ) );
+
+            fflush( stdout );   // not to be repeated by the child
+            fflush( stderr );
+
+            pid = fork();
+            if (pid < 0)
+            {
+                int error = errno;
+                close( fds[0] );
+                close( fds[1] );
+                ThrowError( std::system_error( error, std::generic_category(), "Failed to fork point process." ) );
+            }
+
+            if (pid == 0)
+            {
+                // point process
+                RunChildProcess( [&, this]()
+                {
+                    close( fds[0] );
+
+                    InitializeSherpa( param.argv, points[point] );
+
+                    MEStreamWriter writer( fds[1], 1 );
+
+                    auto onResult = [&writer]( uint64_t, int32_t eventId, double eventME, double /*error*/ )
+                    {
+                        writer.Write( eventId, &eventME );
+                    };
+
+                    if (point == 0)
+                    {
+                        std::unique_ptr<EventFileInterface> upInputFile = OpenInputFile( param.inputRootFileName );
+                        EventFileInterface &                inputFile   = *upInputFile;
+
+                        EventShard                  readShard( shard );
+                        EventFileEvent::UniquePtr   upInputEvent = inputFile.AllocateEvent();
+
+                        std::unique_ptr<VertexStreamWriter> upSpillWriter;
+                        if (spillFd >= 0)
+                            upSpillWriter.reset( new VertexStreamWriter( spillFd ) );
+
+                        EvaluateShard( [&]( uint64_t & entry, int32_t & eventId, EventFileVertex & vertex )
+                                       {
+                                           if (!readShard.ReadVertex( inputFile, *upInputEvent, entry, eventId, vertex ))
+                                               return false;
+
+                                           if (upSpillWriter)
+                                               upSpillWriter->Write( entry, eventId, vertex );
+                                           return true;
+                                       },
+                                       param.eventWindow, onResult );
+
+                        if (upSpillWriter)
+                        {
+                            upSpillWriter->Close();
+                            LogMsgInfo( "Spilled %llu events for the other points.", FMT_LLU(upSpillWriter->NRecords()) );
+                        }
+                    }
+                    else
+                    {
+                        VertexStreamReader spill( spillFd );
+                        spill.Rewind();     // the file offset is shared with the earlier point processes
+
+                        EvaluateShard( [&spill]( uint64_t & entry, int32_t & eventId, EventFileVertex & vertex )
+                                       {
+                                           return spill.Read( entry, eventId, vertex );
+                                       },
+                                       param.eventWindow, onResult );
+                    }
+
+                    writer.Finish();
+
+                    LogDuplicates();
+
+                    if (m_upStore)
+                    {
+                        m_upStore->Flush();
+                        LogMsgInfo( "ME store: %llu found, %llu added, %llu hash collisions.", FMT_LLU(m_upStore->NFound()), FMT_LLU(m_upStore->NAdded()),
+                                    FMT_LLU(m_upStore->NCollisions()) );
+                    }
+                } );
+            }
+
+            close( fds[1] );
+            meFd = fds[0];
+
+            // collect the point's matrix elements; the other points must return the events of the first
+
+            MEStreamReader reader;
+            size_t         event = 0;
+
+            auto onRecord = [&]( int32_t eventId, const double * pME, size_t )
+            {
+                if (point == 0)
+                {
+                    entries.push_back( shard.Entry( ids.size() ) );
+                    ids    .push_back( eventId );
+                    me.resize( me.size() + nPoints );
+                }
+                else if ((event >= ids.size()) || (ids[event] != eventId))
+                {
+                    ThrowError( "Spilled events do not match the events of the first point." );
+                }
+
+                me[event * nPoints + point] = *pME;
+                ++event;
+            };
+
+            char    buffer[1 << 16];
+            ssize_t nRead = 0;
+            while ((nRead = read( meFd, buffer, sizeof(buffer) )) != 0)
+            {
+                if (nRead < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    ThrowError( std::system_error( errno, std::generic_category(), "Failed to read point process results." ) );
+                }
+
+                reader.Parse( buffer, static_cast<size_t>(nRead), onRecord );
+            }
+
+            close( meFd );
+            meFd = -1;
+
+            int status = 0;
+            while ((waitpid( pid, &status, 0 ) < 0) && (errno == EINTR))
+                continue;
+            pid = -1;
+
+            if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0) || !reader.Complete())
+                ThrowError( "Point " + std::to_string(point + 1) + " process failed." );
+
+            if (event != ids.size())
+                ThrowError( "Spilled events do not match the events of the first point." );
+
+            LogMsgInfo( "Point %u completed. %llu events (%u seconds)", FMT_U(point + 1), FMT_LLU(ids.size()), FMT_U(time(nullptr) - timeStartPoint) );
+        }
+    }
+    catch (...)
+    {
+        if (meFd >= 0)
+            close( meFd );
+
+        if (pid > 0)
+        {
+            kill( pid, SIGTERM );
+            waitpid( pid, nullptr, 0 );
+        }
+
+        if (spillFd >= 0)
+            close( spillFd );
+        throw;
+    }
+
+    if (spillFd >= 0)
+        close( spillFd );   // removes the spill file
+
+    // gather the results of all ranks
+
+    if (m_mpiSize > 1)
+    {
+        const int launchRank = m_mpiRank;
+        const int launchSize = m_mpiSize;
+
+        StartMPI();
+
+        if ((m_mpiRank != launchRank) || (m_mpiSize != launchSize))
+            ThrowError( "MPI rank " + std::to_string(m_mpiRank) + " of " + std::to_string(m_mpiSize) + " differs from the rank " +
+                        std::to_string(launchRank) + " of " + std::to_string(launchSize) + " the events were sharded by." );
+
+        GatherToRoot( entries );
+        GatherToRoot( ids     );
+        GatherToRoot( me      );
+
+        if (m_mpiRank != 0)
+        {
+            LogMsgInfo( "Matrix elements sent to MPI rank 0. (%u seconds)", FMT_U(time(nullptr) - timeStartRun) );
+            return EXIT_SUCCESS;
+        }
+    }
+
+    // write the output in entry order
+
+    MEOutput output( param.outputRootFileName, nPoints, true );
+
+    for (size_t event : EntryOrder( entries ))
+        output.Fill( ids[event], me.data() + event * nPoints, entries[event] );
+
+    output.Close();
+
+    time_t timeStopProcess = time(nullptr);
+
+    LogMsgInfo( "%llu events completed. (%u seconds)", FMT_LLU(ids.size()), FMT_U(timeStopProcess - timeStartProcess) );
+    LogMsgInfo( "Done. (%u seconds)", FMT_U(timeStopProcess - timeStartRun) );
+
+    return EXIT_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Server mode: serve matrix element requests (see MEServer.h) one connection at a time until a
+// QUIT request. Sherpa is only initialized once per process, so this process never initializes it:
+// each connection is handed to a point process forked for the parameter point of the request. The
+// point process stays for consecutive requests of its point; a request for another point ends it
+// and starts a new one.
+
+int SherpaMEProgram::RunServer( const RunParameters & param )
+{
+    struct PointProcess
+    {
+        pid_t       pid         = -1;
+        int         controlFd   = -1;   // passes the connections and returns an acknowledgement per connection
+        std::string point;              // PointArgsHash of the requests it serves
+    };
+
+    signal( SIGPIPE, SIG_IGN );     // a client closing its connection early must not stop the server
+
+    int listenFd = MEServerListen( param.serverSocketPath );
+
+    LogMsgInfo( "SherpaME server listening on %hs", FMT_HS(param.serverSocketPath.c_str()) );
+
+    PointProcess process;
+    uint64_t     nRequests = 0;
+
+    auto stopProcess = [&process]()     // after its current connection, which the server waits for anyway
+    {
+        if (process.pid <= 0)
+            return;
+
+        close( process.controlFd );
+
+        int status = 0;
+        while ((waitpid( process.pid, &status, 0 ) < 0) && (errno == EINTR))
+            continue;
+
+        if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+            LogMsgWarning( "SherpaME point process %i failed.", FMT_I(process.pid) );
+
+        process = PointProcess();
+    };
+
+    auto startProcess = [&, this]( int connectionFd, const std::string & point )
+    {
+        int fds[2];
+        if (socketpair( AF_UNIX, SOCK_STREAM, 0, fds ) != 0)
+            ThrowError( std::system_error( errno, std::generic_category(), "Failed to create point process socket." ) );
+
+        fflush( stdout );   // not to be repeated by the child
+        fflush( stderr );
+
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            int error = errno;
+            close( fds[0] );
+            close( fds[1] );
+            ThrowError( std::system_error( error, std::generic_category(), "Failed to fork point process." ) );
+        }
+
+        if (pid == 0)
+        {
+            // the connection is passed over the socket; an inherited copy would keep it open after the reply
+            close( connectionFd );
+            close( listenFd );
+            close( fds[0] );
+
+            RunChildProcess( [&, this]() { ServePoint( fds[1], param ); } );
+        }
+
+        close( fds[1] );
+
+        process.pid       = pid;
+        process.controlFd = fds[0];
+        process.point     = point;
+
+        LogMsgInfo( "SherpaME point process %i started for point %hs.", FMT_I(pid), FMT_HS(point.c_str()) );
+    };
+
+    try
+    {
+        for (bool bQuit = false; !bQuit; )
+        {
+            int fd = accept( listenFd, nullptr, nullptr );
+            if (fd < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                ThrowError( std::system_error( errno, std::generic_category(), "Failed to accept SherpaME server connection." ) );
+            }
+
+            try
+            {
+                MEServerRequest request;
+                MEServerReadRequest( fd, request );
+
+                if (request.bQuit)
+                {
+                    LogMsgInfo( "SherpaME server stopping after %llu requests.", FMT_LLU(nRequests) );
+                    stopProcess();
+                    MEServerWriteLine( fd, "OK" );
+                    bQuit = true;
+                }
+                else
+                {
+                    ++nRequests;
+
+                    // requests name their own result directory and parameter card, so only the point they select is compared
+                    std::string point = HashToString( PointArgsHash( request.sherpaArgs ) );
+
+                    if (process.point != point)
+                        stopProcess();
+
+                    if (process.pid <= 0)
+                        startProcess( fd, point );
+
+                    try
+                    {
+                        MEServerSendConnection( process.controlFd, fd, request );
+                    }
+                    catch (...)
+                    {
+                        stopProcess();
+                        throw;
+                    }
+
+                    // the point process replies; wait until it is done with the connection
+
+                    char    ack   = 0;
+                    ssize_t nRead = 0;
+                    while (((nRead = read( process.controlFd, &ack, 1 )) < 0) && (errno == EINTR))
+                        continue;
+
+                    if (nRead != 1)
+                        stopProcess();  // it ended with the request, e.g. if Sherpa failed to initialize
+                }
+            }
+            catch (const std::exception & error)
+            {
+                ReplyError( fd, error.what() );
+            }
+
+            close( fd );
+        }
+    }
+    catch (...)
+    {
+        stopProcess();
+        close( listenFd );
+        throw;
+    }
+
+    close( listenFd );
+    unlink( param.serverSocketPath.c_str() );
+
+    return EXIT_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The point process serves the connections the server passes over controlFd until the server closes
+// it. Sherpa is initialized with the first request; if that fails the process ends after replying,
+// rather than initializing Sherpa a second time, and the server starts a new one for the next request.
+
+void SherpaMEProgram::ServePoint( int controlFd, const RunParameters & param )
+{
+    int             fd = -1;
+    MEServerRequest request;
+
+    while (MEServerReceiveConnection( controlFd, fd, request ))
+    {
+        ServeConnection( fd, param, request );
+
+        if (!m_upEvaluator)
+            break;
+
+        const char ack = 1;
+        if (write( controlFd, &ack, 1 ) != 1)
+            break;
+    }
+
+    LogDuplicates();
+    close( controlFd );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void SherpaMEProgram::ServeConnection( int fd, const RunParameters & param, const MEServerRequest & request )
+{
+    std::string errorMsg;
+    bool        bReplied = false;  // OK was sent, so an error can only end the stream early
+
+    try
+    {
+        ServeRequest( fd, param, request, bReplied );
+    }
+    catch (const ATOOLS::Exception & error)
+    {
+        errorMsg = "Sherpa Exception: " + error.Info();
+    }
+    catch (const std::exception & error)
+    {
+        errorMsg = error.what();
+    }
+
+    if (!errorMsg.empty())
+    {
+        if (bReplied)   // the client sees a stream without its end record
+            LogMsgError( "Request failed: %hs", FMT_HS(errorMsg.c_str()) );
+        else
+            ReplyError( fd, errorMsg );
+    }
+
+    close( fd );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Sherpa is initialized and the input opened before the reply, so their errors are reported as
+// such; the events are then read, evaluated and streamed in windows, as in a SherpaME run.
+
+void SherpaMEProgram::ServeRequest( int fd, const RunParameters & param, const MEServerRequest & request, bool & bReplied )
+{
+    time_t timeStart = time(nullptr);
+
+    bool bInitialize = !m_upEvaluator;  // all requests of a point process select its point (see RunServer)
+    if (bInitialize)
+        InitializeSherpa( param.argv, request.sherpaArgs );
+
+    std::unique_ptr<EventFileInterface> upInputFile = OpenInputFile( request.inputFile );
+    EventFileInterface &                inputFile   = *upInputFile;
+
+    int streamFd = dup( fd );   // owned by the writer
+    if (streamFd < 0)
+        ThrowError( std::system_error( errno, std::generic_category(), "Failed to duplicate connection." ) );
+
+    MEStreamWriter writer( streamFd, 1 );
+
+    MEServerWriteLine( fd, "OK" );
+    bReplied = true;
+
+    EventShard                  shard( inputFile.Count(), 0, 1 );
+    EventFileEvent::UniquePtr   upInputEvent = inputFile.AllocateEvent();
+    uint64_t                    nEvents = 0;
+
+    EvaluateShard( [&]( uint64_t & entry, int32_t & eventId, EventFileVertex & vertex )
+                   {
+                       return shard.ReadVertex( inputFile, *upInputEvent, entry, eventId, vertex );
+                   },
+                   param.eventWindow,
+                   [&writer, &nEvents]( uint64_t, int32_t eventId, double me, double )
+                   {
+                       writer.Write( eventId, &me );
+                       ++nEvents;
+                   } );
+
+    if (m_upStore)
+        m_upStore->Flush();
+
+    writer.Finish();
+
+    LogMsgInfo( "Request: %llu events from %hs, %hs (%u seconds)", FMT_LLU(nEvents), FMT_HS(request.inputFile.c_str()),
+                FMT_HS(bInitialize ? "initialized" : "warm"), FMT_U(time(nullptr) - timeStart) );
 }
@@ -7,6 +7,8 @@
 
 #include "common.h"
 
+#include <functional>
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // forward declarations
 
@@ -15,17 +17,13 @@ namespace SHERPA
 class Sherpa;
 }
 
-namespace ATOOLS
-{
-template<typename>
-class Vec4;
-
-typedef Vec4<double>            Vec4D;
-typedef std::vector<Vec4D>      Vec4D_Vector;
-}
+class SherpaMEEvaluator;
+class MatrixElementStore;
+class EventShard;
 
 struct EventFileVertex;
-struct MERootEvent;
+struct EventFileInterface;
+struct MEServerRequest;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -36,6 +34,14 @@ public:
     {
         std::string     inputRootFileName;
         std::string     outputRootFileName;
+        std::string     pointsFileName;         // optional; evaluate every event at each parameter point listed
+        std::string     meStorePath;            // optional; directory of a persistent matrix element store
+        std::string     serverSocketPath;       // server mode; evaluate requests received on this Unix socket
+        double          colorPrecision = 0;     // optional; sample the colour sum to this relative precision
+        size_t          eventWindow = 256;      // events buffered and grouped by subprocess before evaluation
+        size_t          nWorkers = 1;           // forked processes sharing the events of this rank
+        bool            bSoak = false;          // log resident memory every million events, fail if it grows
+        size_t          dedupEntries = 65536;   // matrix elements kept to skip repeated phase space points (0 = off)
 
         std::vector<const char *> argv;
     };
@@ -49,12 +55,37 @@ public:
     int Run( const RunParameters & param );
     
 private:
-    bool ProcessEvent( int32_t eventId, const EventFileVertex & inputEvent, MERootEvent & outputEvent );     // returns true if valid outputEvent generated
+    typedef std::vector<std::string>    StringVector;
+
+    typedef std::function<bool( uint64_t & entry, int32_t & eventId, EventFileVertex & vertex )> VertexSource;   // returns false after the last event
+    typedef std::function<void( uint64_t entry, int32_t eventId, double me, double error )> ResultHandler;
+
+    void InitializeMPI( const RunParameters & param );
+    void StartMPI();
+    void InitializeSherpa( const std::vector<const char *> & argv, const StringVector & extraArgs = StringVector() );
+
+    void EvaluateShard( const VertexSource & onRead, size_t windowSize, const ResultHandler & onResult );
+    void RunWorkers( const RunParameters & param, EventFileInterface & inputFile, EventShard & shard, const ResultHandler & onResult );
+
+    int RunPoints( const RunParameters & param, time_t timeStartRun );
+    int RunServer( const RunParameters & param );
+
+    void ServePoint( int controlFd, const RunParameters & param );     // in a point process of the server
+    void ServeConnection( int fd, const RunParameters & param, const MEServerRequest & request );
+    void ServeRequest( int fd, const RunParameters & param, const MEServerRequest & request, bool & bReplied );
+
+    void LogDuplicates() const;
 
-    double GetEventME( size_t nInParticles, const std::vector<int> & particleCodes, const ATOOLS::Vec4D_Vector & particleMomenta );
-    
 private:
-    std::unique_ptr<SHERPA::Sherpa> m_upSherpa;
+    std::unique_ptr<SHERPA::Sherpa>     m_upSherpa;
+    std::unique_ptr<SherpaMEEvaluator>  m_upEvaluator;
+    std::unique_ptr<MatrixElementStore> m_upStore;
+    double                              m_colorPrecision = 0;
+    size_t                              m_dedupEntries   = 0;
+    bool                                m_bSoak          = false;
+    int                                 m_mpiRank   = 0;    // events are sharded across MPI ranks,
+    int                                 m_mpiSize   = 1;    // rank 0 writes the output
+    bool                                m_bMPIInitialized = false;  // not with worker processes or a server, late with points (see InitializeMPI)
 
 private:
     SherpaMEProgram(const SherpaMEProgram &) = delete;
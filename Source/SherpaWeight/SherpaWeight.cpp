@@ -4,11 +4,30 @@
 
 #include "SherpaWeight.h"
 #include "MERootEvent.h"
+#include "MEStream.h"
+#include "MEServer.h"
 
 #include "common.h"
 #include "SherpaDataReader.h"
 
 #include <limits>
+#include <climits>
+#include <cmath>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <dirent.h>
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Sherpa and Root include files
@@ -18,17 +37,149 @@
 #include <SHERPA/Initialization/Initialization_Handler.H>
 #include <MODEL/Main/Model_Base.H>
 #include <ATOOLS/Org/Run_Parameter.H>
+#include <ATOOLS/Math/Vector.H>
 
 // Root includes
 #include <TFile.h>
 #include <TTree.h>
 #include <TMatrixD.h>
 #include <TDecompLU.h>
+#include <RVersion.h>
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+#include <TROOT.h>
+#else
+#include <TThread.h>
+#endif
+
+// OpenMPI includes
+#include <mpi.h>
+
+extern char ** environ;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // class SherpaWeight
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+struct MatrixElementRecord  // transferred between MPI ranks
+{
+    int32_t     eventId;
+    uint32_t    run;
+    double      me;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Runs posted jobs in order on a background thread.
+
+class BackgroundWorker
+{
+public:
+    BackgroundWorker()
+    {
+        // root file access from more than one thread must be enabled first
+        static std::once_flag rootThreadsFlag;
+        std::call_once( rootThreadsFlag, []()
+        {
+        #if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+            ROOT::EnableThreadSafety();
+        #else
+            TThread::Initialize();
+        #endif
+        } );
+
+        m_thread = std::thread( &BackgroundWorker::Process, this );
+    }
+
+    ~BackgroundWorker() throw()
+    {
+        try
+        {
+            Finish();
+        }
+        catch (...)
+        {
+            // errors only reported by explicit call to Finish
+        }
+    }
+
+    void Post( std::function<void()> job )
+    {
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            m_jobs.push( std::move(job) );
+        }
+        m_condition.notify_one();
+    }
+
+    void Finish()   // waits for all posted jobs; rethrows the first job error
+    {
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            m_bFinish = true;
+        }
+        m_condition.notify_one();
+
+        if (m_thread.joinable())
+            m_thread.join();
+
+        if (m_error)
+        {
+            std::exception_ptr error = m_error;
+            m_error = nullptr;
+            std::rethrow_exception( error );
+        }
+    }
+
+private:
+    void Process()
+    {
+        for (;;)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock( m_mutex );
+                m_condition.wait( lock, [this]() { return !m_jobs.empty() || m_bFinish; } );
+
+                if (m_jobs.empty())
+                    return;
+
+                job = std::move( m_jobs.front() );
+                m_jobs.pop();
+            }
+
+            if (m_error)
+                continue;   // skip remaining jobs after a failure
+
+            try
+            {
+                job();
+            }
+            catch (...)
+            {
+                m_error = std::current_exception();
+            }
+        }
+    }
+
+private:
+    std::mutex                          m_mutex;
+    std::condition_variable             m_condition;
+    std::queue<std::function<void()>>   m_jobs;
+    bool                                m_bFinish   = false;
+    std::exception_ptr                  m_error;            // only accessed by the worker thread until joined
+    std::thread                         m_thread;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+struct SherpaWeight::EvaluationTask
+{
+    std::vector<size_t> runs;           // evaluation runs, in the order of the output file
+    std::string         command;
+    std::string         outputFile;
+    std::string         logFile;
+    std::string         markerFile;     // created once the output file is complete and loaded
+    bool                bStream = false;    // results are streamed over a pipe, no output or marker file
+};
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 SherpaWeight::SherpaWeight()
     : m_upSherpa( new SHERPA::Sherpa )
@@ -59,6 +210,10 @@ void SherpaWeight::Initialize( const std::string & eventFileName, const std::vec
     
     m_eventFileName = eventFileName;
     m_argv          = argv;
+
+    // the input file contents identify the evaluation setup (see EvaluationSetupHash); hashed once,
+    // as the hash is needed for every run and manifest
+    m_eventFileHash = HashFile( m_eventFileName );
     
     {
         std::string application( argv[0] );
@@ -103,12 +258,61 @@ void SherpaWeight::Initialize( const std::string & eventFileName, const std::vec
         std::string runFileSection  = pInitHandler->File();
         std::string runFileBase     = runFileSection.substr( 0, runFileSection.find("|") );  // strip off section declaration following '|'
 
+        m_sherpaRunFile = runFileBase;
+
         DefaultDataReader reader( SherpaRunPath(), runFileSection );
 
         // Note: By default, DefaultDataReader (Data_Reader) appends the (run) section and command line parameters to the section of the file it is reading.
 
         m_sherpaWeightFileSection = reader.GetValue<std::string>( "SHERPA_WEIGHT_FILE", runFileBase + "|(SherpaWeight){|}(SherpaWeight)" );
         LogMsgInfo( "Configuration:\t" + m_sherpaWeightFileSection );
+
+        SetEvaluationJobs( reader.GetValue<size_t>( "SHERPA_WEIGHT_JOBS", 1 ) );
+        LogMsgInfo( "Evaluation Jobs:\t%u", FMT_U(EvaluationJobs()) );
+
+        std::string engine = reader.GetValue<std::string>( "SHERPA_WEIGHT_ENGINE", "SherpaME" );
+        if (engine == "SherpaME")
+            SetEngine( EvaluationEngine::SherpaME );
+        else if (engine == "MultiPoint")
+            SetEngine( EvaluationEngine::MultiPoint );
+        else if (engine == "Server")
+            SetEngine( EvaluationEngine::Server );
+        else
+            ThrowError( "Unknown SHERPA_WEIGHT_ENGINE (" + engine + "). Use SherpaME, MultiPoint or Server." );
+        LogMsgInfo( "Evaluation Engine:\t" + engine );
+
+        if (Engine() == EvaluationEngine::Server)
+        {
+            SetServerSockets( reader.GetValue<std::string>( "SHERPA_WEIGHT_SERVERS", "" ) );
+            if (ServerSockets().empty())
+                ThrowError( "SHERPA_WEIGHT_SERVERS must list the SherpaME server sockets of the Server engine." );
+            LogMsgInfo( "SherpaME Servers:\t%u", FMT_U(ServerSockets().size()) );
+        }
+
+        SetResume( reader.GetValue<int>( "SHERPA_WEIGHT_RESUME", 1 ) != 0 );
+        LogMsgInfo( "Resume Runs:\t\t%hs", FMT_HS(Resume() ? "yes" : "no") );
+
+        SetReusePoints( reader.GetValue<int>( "SHERPA_WEIGHT_REUSE_POINTS", 0 ) != 0 );
+        LogMsgInfo( "Reuse Points:\t\t%hs", FMT_HS(ReusePoints() ? "yes" : "no") );
+
+        SetStreamResults( reader.GetValue<int>( "SHERPA_WEIGHT_STREAM", 0 ) != 0 );
+        LogMsgInfo( "Stream Results:\t\t%hs", FMT_HS(StreamResults() ? "yes" : "no") );
+        if (StreamResults() && ((Engine() == EvaluationEngine::SherpaME) || (Engine() == EvaluationEngine::MultiPoint)) && Resume())
+            LogMsgInfo( "Streamed results are not kept, so SherpaME runs will not be resumed." );
+
+        SetMEStorePath( reader.GetValue<std::string>( "SHERPA_WEIGHT_ME_STORE", "" ) );
+        if (!MEStorePath().empty())
+            LogMsgInfo( "ME Store:\t\t" + MEStorePath() );
+    }
+
+    // split the evaluation runs across MPI ranks
+    if (MPI::Is_initialized())
+    {
+        m_mpiRank = MPI::COMM_WORLD.Get_rank();
+        m_mpiSize = MPI::COMM_WORLD.Get_size();
+
+        if (MPISize() > 1)
+            LogMsgInfo( "MPI Ranks:\t\t%i (this rank %i)", FMT_I(MPISize()), FMT_I(MPIRank()) );
     }
 
     // determine and create temporary work directory
@@ -152,204 +356,1277 @@ void SherpaWeight::Initialize( const std::string & eventFileName, const std::vec
         m_pModel->Initialize( *this, reader );
     }
 
-    // optionally read reweight parameters from file
-    
-    if (bReadParameters)
-        ReadParametersFromFile();
+    // optionally read reweight parameters from file
+    
+    if (bReadParameters)
+        ReadParametersFromFile();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void SherpaWeight::ReadParametersFromFile( const char * /*filePath*/ /*= nullptr*/ )
+{
+    ParameterVector params;
+
+    DefaultDataReader reader( SherpaRunPath(), m_sherpaWeightFileSection );
+
+    // Note: By default, DefaultDataReader (Data_Reader) appends the (run) section and command line parameters to the section of the file it is reading.
+    reader.SetAddCommandLine(false);  // read the raw file input
+    
+    std::vector< std::vector<std::string> > stringMatrix;
+    if (reader.MatrixFromFile( stringMatrix ))
+    {
+        params.reserve( stringMatrix.size() );    // reserve space for all entries
+        
+        for ( const auto & row : stringMatrix )
+        {
+            if (!row.size())    // skip empty rows (probably not necessary, but just for caution sake)
+                continue;
+            
+            ReweightParameter param;
+            
+            param.name = row[0];
+            
+            if (row.size() > 1)
+            {
+                try
+                {
+                    // could use ATOOLS::ToType<double>(), but that doesn't check if the conversion failed
+                    // use std::stringstream instead
+                    
+                    // TODO: try using std::stof
+                    
+                    std::stringstream stream;
+                    stream.precision(12);
+                    
+                    stream << row[1];
+                    stream >> param.offset;
+                    if (stream.fail() || !stream.eof())
+                        ThrowError( "Could not convert string to floating point value." );  // caught below
+                    
+                    if (row.size() > 2)
+                    {
+                        stream.clear();
+                        stream << row[2];
+                        stream >> param.scale;
+                        if (stream.fail() || !stream.eof())
+                            ThrowError( "Could not convert string to floating point value." );  // caught below
+                    }
+                }
+                catch (const std::exception &)
+                {
+                    ThrowError( "Failed to read expansion point/delta for reweight parameter " + param.name );
+                }
+            }
+            
+            params.push_back( std::move(param) );
+        }
+    }
+    
+    SetParameters( params );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void SherpaWeight::SetParameters( const ParameterVector & params )
+{
+    // ensure all names are unique
+    {
+        std::set<std::string> duplicateNames;
+
+        for (auto itr1 = params.cbegin(), end = params.cend(); itr1 != end; ++itr1)
+        {
+            for (auto itr2 = itr1 + 1; itr2 != end; ++itr2)
+            {
+                if (itr1->name == itr2->name)
+                {
+                    duplicateNames.insert( itr1->name );
+                    break;
+                }
+            }
+        }
+
+        if (!duplicateNames.empty())
+        {
+            std::string strDup;
+            for (const std::string & s : duplicateNames)
+            {
+                if (!strDup.empty()) strDup += ", ";
+                strDup += s;
+            }
+            
+            ThrowError( "Duplicate reweight parameters: " + strDup );
+        }
+    }
+
+    // validate parameters with model
+    m_pModel->ValidateParameters(params);
+
+    // set the parameters
+    m_parameters = params;
+
+    LogMsgInfo( "Reweight parameters (" + std::to_string(m_parameters.size()) + "):" );
+    for (const auto & p : m_parameters)
+        LogMsgInfo( "  " + p.name );
+    LogMsgInfo( "" );
+
+    // calculate bilinear matrices
+    
+    GetBilinearMatrices( m_parameters, m_evalMatrix, m_invCoefMatrix, m_coefNames );
+
+    LogMsgInfo( "Reweight coefficients (" + std::to_string(m_coefNames.size()) + "):" );
+    for (const auto & n : m_coefNames)
+        LogMsgInfo( "  " + n );
+    LogMsgInfo( "" );
+
+    m_matrixElements.clear();  // cleanup any previous run
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void SherpaWeight::SetEvaluationJobs( size_t nJobs )
+{
+    if (nJobs == 0)
+    {
+        long nProcessors = sysconf( _SC_NPROCESSORS_ONLN );
+        nJobs = (nProcessors > 0) ? static_cast<size_t>(nProcessors) : 1;
+    }
+
+    m_nJobs = nJobs;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void SherpaWeight::SetMEStorePath( const std::string & path )
+{
+    // relative paths are relative to the sherpa run path, as SherpaME runs elsewhere
+    if (!path.empty() && (path[0] != '/'))
+        m_meStorePath = SherpaRunPath() + path;
+    else
+        m_meStorePath = path;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void SherpaWeight::SetServerSockets( const std::string & socketList )
+{
+    m_serverSockets.clear();
+
+    size_t start = 0;
+    for (size_t end; start <= socketList.size(); start = end + 1)
+    {
+        end = socketList.find( ',', start );
+        if (end == std::string::npos)
+            end = socketList.size();
+
+        std::string path = socketList.substr( start, end - start );
+        if (path.empty())
+            continue;
+
+        // relative paths are relative to the sherpa run path, as for the ME store
+        m_serverSockets.push_back( (path[0] != '/') ? SherpaRunPath() + path : path );
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+std::string SherpaWeight::EvaluationRunString( size_t run ) const
+{
+    char runString[20];
+    sprintf( runString, "%02u", FMT_U(run + 1) );
+    return runString;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+std::string SherpaWeight::EvaluationWorkPath( size_t run ) const
+{
+    return TemporaryPath() + "Run_" + EvaluationRunString(run) + "/";
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+uint64_t SherpaWeight::EvaluationSetupHash() const
+{
+    uint64_t hash = HashString( m_eventFileName );
+
+    // input file contents, hashed at initialization
+    hash = HashValue( m_eventFileHash, hash );
+
+    // sherpa setup, including the contents of the run file and of the model's parameter card
+    hash = HashString( SherpaRunPath(), hash );
+    for (size_t i = 1; i < m_argv.size(); ++i)
+        hash = HashString( m_argv[i], hash );
+
+    hash = HashFile( SherpaRunPath() + m_sherpaRunFile, hash );
+    if (m_pModel)
+    {
+        for (const std::string & filePath : m_pModel->InputFiles())
+            hash = HashFile( filePath, hash );
+    }
+
+    return hash;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+std::string SherpaWeight::EvaluationRunKey( size_t run ) const
+{
+    uint64_t hash = EvaluationSetupHash();
+
+    // parameter point
+    for (size_t i = 0; i < m_parameters.size(); ++i)
+    {
+        hash = HashString( m_parameters[i].name,   hash );
+        hash = HashValue(  m_parameters[i].scale,  hash );
+        hash = HashValue(  m_parameters[i].offset, hash );
+        hash = HashValue(  m_evalMatrix[run][i],   hash );
+    }
+
+    return HashToString( hash );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool FileExists( const std::string & filePath )
+{
+    struct stat info;
+    return (stat( filePath.c_str(), &info ) == 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static void CreateMarkerFile( const std::string & filePath )
+{
+    FILE * pFile = fopen( filePath.c_str(), "w" );
+    if (!pFile || (fclose( pFile ) != 0))
+        LogMsgWarning( "Failed to create marker file (%hs). Run will not be resumed.", FMT_HS(filePath.c_str()) );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static const int StreamFd = 3;   // descriptor of the result stream in a SherpaME process (output file fd:3)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static pid_t StartCommand( const std::string & command, int streamFd = -1 )
+{
+    // drop the MPI launcher variables, otherwise an MPI program run by the command (SherpaME)
+    // tries to join the job of this rank instead of running as a singleton
+    std::vector<char *> envp;
+    for (char ** ppEnv = environ; *ppEnv; ++ppEnv)
+    {
+        if ((strncmp( *ppEnv, "OMPI_", 5 ) != 0) && (strncmp( *ppEnv, "PMI_", 4 ) != 0) && (strncmp( *ppEnv, "PMIX_", 5 ) != 0))
+            envp.push_back( *ppEnv );
+    }
+    envp.push_back( nullptr );
+
+    pid_t pid = fork();
+    if (pid < 0)
+        ThrowError( std::system_error( errno, std::generic_category(), "Failed to fork process for command." ) );
+
+    if (pid == 0)
+    {
+        // child process: run the command through the shell, as system() does
+        if (streamFd >= 0)
+        {
+            if (dup2( streamFd, StreamFd ) < 0)
+                _exit( 127 );
+            if (streamFd != StreamFd)
+                close( streamFd );
+        }
+
+        execle( "/bin/sh", "sh", "-c", command.c_str(), static_cast<char *>(nullptr), envp.data() );
+        _exit( 127 );   // only reached if exec failed
+    }
+
+    return pid;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Self-pipe that becomes readable when a child process exits, so that waiting for the evaluation
+// runs can poll on it together with their result streams and then reap only the runs it started.
+// Installs a SIGCHLD handler for its lifetime; only one may exist at a time.
+
+class ChildExitPipe
+{
+public:
+    ChildExitPipe()
+    {
+        int fds[2];
+        if (pipe( fds ) != 0)
+            ThrowError( std::system_error( errno, std::generic_category(), "Failed to create child exit pipe." ) );
+
+        for (int fd : fds)
+        {
+            fcntl( fd, F_SETFD, FD_CLOEXEC );
+            fcntl( fd, F_SETFL, fcntl( fd, F_GETFL ) | O_NONBLOCK );     // the handler must never block
+        }
+
+        m_readFd   = fds[0];
+        s_writeFd  = fds[1];
+
+        struct sigaction action = {};
+        action.sa_handler = OnChildExit;
+        action.sa_flags   = SA_RESTART | SA_NOCLDSTOP;
+        sigemptyset( &action.sa_mask );
+
+        if (sigaction( SIGCHLD, &action, &m_previousAction ) != 0)
+        {
+            int error = errno;
+            Close();
+            ThrowError( std::system_error( error, std::generic_category(), "Failed to install SIGCHLD handler." ) );
+        }
+    }
+
+    ~ChildExitPipe() throw()
+    {
+        sigaction( SIGCHLD, &m_previousAction, nullptr );
+        Close();
+    }
+
+    int ReadFd() const throw()  { return m_readFd; }
+
+    void Drain() throw()        // before checking the children, so that a later exit wakes the next poll
+    {
+        char buffer[64];
+        while (read( m_readFd, buffer, sizeof(buffer) ) > 0)
+            ;
+    }
+
+private:
+    static void OnChildExit( int )
+    {
+        int savedErrno = errno;
+        const char c = 0;
+        ssize_t result = write( s_writeFd, &c, 1 );     // a full pipe is readable already
+        (void) result;
+        errno = savedErrno;
+    }
+
+    void Close() throw()
+    {
+        int writeFd = s_writeFd;
+        s_writeFd = -1;
+        close( writeFd  );
+        close( m_readFd );
+    }
+
+private:
+    static volatile sig_atomic_t    s_writeFd;
+    int                             m_readFd = -1;
+    struct sigaction                m_previousAction = {};
+
+private:
+    ChildExitPipe(const ChildExitPipe &) = delete;
+    ChildExitPipe & operator=(const ChildExitPipe &) = delete;
+};
+
+volatile sig_atomic_t ChildExitPipe::s_writeFd = -1;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void SherpaWeight::EvaluateEvents( const std::function<void()> & onLastRunStarted /*= nullptr*/ )
+{
+    size_t nEvaluations = NEvaluations();
+    
+    m_matrixElements.clear();  // cleanup any previous run
+
+    m_onLastRunStarted = onLastRunStarted;
+
+    if (nEvaluations == 0)
+    {
+        NotifyLastRunStarted();
+        return;
+    }
+
+    // this rank's share of the evaluation runs
+    std::vector<size_t> runs;
+    for (size_t run = MPIRank(); run < nEvaluations; run += MPISize())
+        runs.push_back( run );
+
+    std::exception_ptr evalError;
+    try
+    {
+        if (ReusePoints())
+            ReuseStoredPoints( runs );
+
+        if (!runs.empty())
+        {
+            switch (Engine())
+            {
+                case EvaluationEngine::MultiPoint:
+                    EvaluateRunsMultiPoint( runs );
+                    break;
+
+                case EvaluationEngine::Server:
+                    EvaluateRunsServer( runs );
+                    break;
+
+                case EvaluationEngine::SherpaME:
+                default:
+                    EvaluateRunsSherpaME( runs );
+                    break;
+            }
+        }
+    }
+    catch (...)
+    {
+        evalError = std::current_exception();
+    }
+
+    if (!evalError)
+        NotifyLastRunStarted();     // in case no run was started
+    m_onLastRunStarted = nullptr;
+
+    if (MPISize() > 1)
+    {
+        // all ranks must agree on success before exchanging results
+        int bFailed    = evalError ? 1 : 0;
+        int bAnyFailed = 0;
+        MPI::COMM_WORLD.Allreduce( &bFailed, &bAnyFailed, 1, MPI::INT, MPI::MAX );
+
+        if (evalError)
+            std::rethrow_exception( evalError );
+        if (bAnyFailed)
+            ThrowError( "Evaluation failed on another MPI rank." );
+
+        GatherMatrixElements();
+
+        if (MPIRank() != 0)
+            return;     // matrix elements now held by rank 0
+    }
+    else if (evalError)
+        std::rethrow_exception( evalError );
+
+    // validate matrix elements
+    {
+        EventMatrixElementMap::iterator itr = m_matrixElements.begin();
+        EventMatrixElementMap::iterator end = m_matrixElements.end();
+        while (itr != end)
+        {
+            size_t nEvaluated = std::count( itr->second.evaluated.begin(), itr->second.evaluated.end(), true );
+
+            if (nEvaluated != nEvaluations)
+            {
+                LogMsgWarning( "Discarding event %i. Evaluations: %u, require: %u.", FMT_I(itr->first), FMT_U(nEvaluated), FMT_U(nEvaluations) );
+                itr = m_matrixElements.erase(itr);  // returned itr is next itr in map
+                continue;
+            }
+            ++itr;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+std::string SherpaWeight::SherpaMECommand( const std::string & outputFile, const std::string & options,
+                                           const std::string & logFile ) const
+{
+    std::string command = "\"" + ApplicationRunPath() + "SherpaME\"";
+
+    command += " \"" + m_eventFileName + "\"";     // input  file
+    command += " \"" + outputFile      + "\"";     // output file
+
+    if (!options.empty())
+        command += " " + options;
+
+    if (!MEStorePath().empty())
+        command += " --me-store \"" + MEStorePath() + "\"";
+
+    // extra sherpa arguments
+    for (size_t i = 1; i < m_argv.size(); ++i)
+        command += std::string(" \"") + m_argv[i] + "\"";
+
+    command += " OUTPUT=2";     // override output level
+    command += " \"LOG_FILE=" + logFile + "\"";
+
+    return command;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void SherpaWeight::EvaluateRunsSherpaME( const std::vector<size_t> & runs )
+{
+    TaskVector tasks;
+
+    for (size_t run : runs)
+    {
+        // setup the run, each in its own work directory
+
+        std::string workPath = EvaluationWorkPath(run);
+
+        if ((mkdir( workPath.c_str(), 0777 ) != 0) && (errno != EEXIST))
+            ThrowError( std::system_error( errno, std::generic_category(), "Failed to create directory (" + workPath + ")" ) );
+
+        EvaluationTask task;
+
+        std::string key = EvaluationRunKey(run);
+
+        task.runs       = { run };
+        task.outputFile = TemporaryPath() + "SherpaME_" + key + ".root";
+        task.markerFile = TemporaryPath() + "SherpaME_" + key + ".done";
+        task.logFile    = TemporaryPath() + "SherpaME_" + EvaluationRunString(run) + ".log";
+
+        if (LoadCompletedResult( task ))
+            continue;
+
+        if (StreamResults())
+            SetStreamOutput( task );
+
+        task.command    = SherpaMECommand( task.outputFile, "", task.logFile );
+
+        task.command   += " \"RESULT_DIRECTORY=" + workPath + "Results\"";
+        task.command   += " " + m_pModel->CommandLineArgs( m_parameters, m_evalMatrix[run], workPath );
+
+        tasks.push_back( std::move(task) );
+    }
+
+    RunEvaluationTasks( tasks );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void SherpaWeight::EvaluateRunsMultiPoint( const std::vector<size_t> & runs )
+{
+    // completed runs are resumed one by one, as the grouping of runs into tasks depends on the
+    // number of jobs and MPI ranks, which may differ from those of the interrupted evaluation
+
+    std::vector<size_t> pendingRuns;
+    for (size_t run : runs)
+    {
+        if (!LoadCompletedRun( run ))
+            pendingRuns.push_back( run );
+    }
+
+    if (pendingRuns.empty())
+        return;
+
+    // spread the runs over at most EvaluationJobs() SherpaME processes; each parses the input once
+    // and replays its events from a spill file at each of its points (see SherpaME --points)
+
+    size_t nTasks = std::min( EvaluationJobs(), pendingRuns.size() );
+
+    TaskVector tasks( nTasks );
+
+    for (size_t i = 0; i < pendingRuns.size(); ++i)
+        tasks[i % nTasks].runs.push_back( pendingRuns[i] );
+
+    for (EvaluationTask & task : tasks)
+    {
+        std::string taskString = EvaluationRunString(task.runs[0]);     // runs are disjoint across tasks and MPI ranks
+        std::string pointsFile = TemporaryPath() + "SherpaME_points_" + taskString + ".dat";
+
+        uint64_t hash = HashSeed;
+        for (size_t run : task.runs)
+            hash = HashString( EvaluationRunKey(run), hash );
+        std::string key = HashToString( hash );
+
+        task.outputFile = TemporaryPath() + "SherpaME_points_" + key + ".root";
+        task.markerFile = TemporaryPath() + "SherpaME_points_" + key + ".done";
+        task.logFile    = TemporaryPath() + "SherpaME_points_" + taskString + ".log";
+
+        if (StreamResults())
+            SetStreamOutput( task );
+
+        // write the points file: one line of tab separated sherpa arguments per run
+        {
+            FILE * pFile = fopen( pointsFile.c_str(), "w" );
+            if (!pFile)
+                ThrowError( std::system_error( errno, std::generic_category(), "Failed to create points file (" + pointsFile + ")" ) );
+
+            for (size_t run : task.runs)
+            {
+                std::string workPath = EvaluationWorkPath(run);
+
+                if ((mkdir( workPath.c_str(), 0777 ) != 0) && (errno != EEXIST))
+                {
+                    fclose( pFile );
+                    ThrowError( std::system_error( errno, std::generic_category(), "Failed to create directory (" + workPath + ")" ) );
+                }
+
+                StringVector sherpaArgs = m_pModel->SherpaArgs( m_parameters, m_evalMatrix[run], workPath );
+                sherpaArgs.push_back( "RESULT_DIRECTORY=" + workPath + "Results" );
+
+                std::string line;
+                for (const std::string & arg : sherpaArgs)
+                {
+                    if (!line.empty()) line += "\t";
+                    line += arg;
+                }
+
+                fprintf( pFile, "%s\n", line.c_str() );
+            }
+
+            if (fclose( pFile ) != 0)
+                ThrowError( std::system_error( errno, std::generic_category(), "Failed to write points file (" + pointsFile + ")" ) );
+        }
+
+        task.command    = SherpaMECommand( task.outputFile, "--points \"" + pointsFile + "\"", task.logFile );
+    }
+
+    RunEvaluationTasks( tasks );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Send the runs to the SherpaME servers, one request at a time per server. Each run is a new
+// parameter point, for which a server forks a new point process that initializes Sherpa (see
+// MEServer.h): a pool of servers only saves the startup of a SherpaME process per run. The servers
+// must run with the same sherpa setup.
+
+void SherpaWeight::EvaluateRunsServer( const std::vector<size_t> & runs )
+{
+    std::string inputFile = m_eventFileName;
+    if (!inputFile.empty() && (inputFile[0] != '/'))
+    {
+        char cwd[PATH_MAX];
+        if (getcwd( cwd, sizeof(cwd) ))
+            inputFile = std::string(cwd) + "/" + inputFile;    // servers run in their own directories
+    }
+
+    std::mutex          mutex;              // guards the members below and m_matrixElements
+    size_t              nextRun = 0;
+    std::exception_ptr  error;
+
+    auto serve = [&]( const std::string & socketPath )
+    {
+        for (;;)
+        {
+            size_t          run = 0;
+            MEServerRequest request;
+
+            try
+            {
+                {
+                    std::lock_guard<std::mutex> lock( mutex );
+                    if (error || (nextRun == runs.size()))
+                        return;
+
+                    run = runs[nextRun++];
+                    LogMsgInfo( "Evaluation Run %u: %hs", FMT_U(run + 1), FMT_HS(socketPath.c_str()) );
+
+                    std::string workPath = EvaluationWorkPath(run);
+
+                    if ((mkdir( workPath.c_str(), 0777 ) != 0) && (errno != EEXIST))
+                        ThrowError( std::system_error( errno, std::generic_category(), "Failed to create directory (" + workPath + ")" ) );
+
+                    request.inputFile  = inputFile;
+                    request.sherpaArgs = m_pModel->SherpaArgs( m_parameters, m_evalMatrix[run], workPath );
+                    request.sherpaArgs.push_back( "RESULT_DIRECTORY=" + workPath + "Results" );
+                }
+
+                std::vector<std::pair<int32_t, double>> results;
+
+                MEServerEvaluate( socketPath, request, [&results]( int32_t id, const double * pME, size_t )
+                {
+                    results.push_back( std::make_pair( id, *pME ) );
+                } );
+
+                std::lock_guard<std::mutex> lock( mutex );
+                for (const auto & result : results)
+                    AddMatrixElement( result.first, run, result.second );
+
+                LogMsgInfo( "Evaluation Run %u completed: %llu events", FMT_U(run + 1), FMT_LLU(results.size()) );
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock( mutex );
+                if (!error)
+                    error = std::current_exception();
+                return;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (const std::string & socketPath : ServerSockets())
+    {
+        if (threads.size() < runs.size())
+            threads.emplace_back( serve, std::cref(socketPath) );
+    }
+
+    for (std::thread & thread : threads)
+        thread.join();
+
+    if (error)
+        std::rethrow_exception( error );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void SherpaWeight::NotifyLastRunStarted()
+{
+    if (m_onLastRunStarted)
+    {
+        std::function<void()> onLastRunStarted;
+        onLastRunStarted.swap( m_onLastRunStarted );   // call only once
+
+        onLastRunStarted();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void SherpaWeight::SetStreamOutput( EvaluationTask & task )  // static
+{
+    // SherpaME writes to the pipe set up by RunEvaluationTasks, nothing is left to resume from
+    task.bStream    = true;
+    task.outputFile = "fd:" + std::to_string(StreamFd);
+    task.markerFile.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void SherpaWeight::RunEvaluationTasks( const TaskVector & tasks )
+{
+    // run tasks, at most EvaluationJobs() at a time
+
+    struct RunningJob
+    {
+        size_t          task        = 0;
+        int             streamFd    = -1;       // read end of the result pipe, -1 once closed
+        bool            bExited     = false;
+        int             status      = 0;
+        bool            bStreamError = false;
+        MEStreamReader  reader;
+    };
+
+    std::map<pid_t, RunningJob> runningJobs;    // child process id -> job
+    size_t                      nextTask    = 0;
+    size_t                      nFailed     = 0;
+
+    ChildExitPipe               childExits;     // before any task is started, so that no exit is missed
+
+    // completed tasks are loaded in the background while the next tasks run;
+    // m_matrixElements is only accessed by the loader until it is finished.
+    // Streamed results are instead added by this thread as they arrive (all tasks use the same mode).
+    BackgroundWorker            loader;
+
+    auto readStream = [this, &tasks]( RunningJob & job )
+    {
+        char    buffer[1 << 16];
+        ssize_t nRead = read( job.streamFd, buffer, sizeof(buffer) );
+
+        if (nRead < 0)
+        {
+            if ((errno == EINTR) || (errno == EAGAIN))
+                return;
+            LogMsgError( "Failed to read matrix element stream: %hs", FMT_HS(strerror( errno )) );
+            job.bStreamError = true;
+        }
+        else if (nRead > 0)
+        {
+            const EvaluationTask & task = tasks[job.task];
+            try
+            {
+                job.reader.Parse( buffer, static_cast<size_t>(nRead), [this, &task]( int32_t id, const double * pME, size_t nPoints )
+                {
+                    if (nPoints != task.runs.size())
+                        ThrowError( "Matrix element stream has " + std::to_string(nPoints) + " points, expected " + std::to_string(task.runs.size()) + "." );
+
+                    for (size_t i = 0; i < nPoints; ++i)
+                        AddMatrixElement( id, task.runs[i], pME[i] );
+                } );
+                return;
+            }
+            catch (const std::exception & error)
+            {
+                LogMsgError( "Invalid matrix element stream: %hs", FMT_HS(error.what()) );
+                job.bStreamError = true;
+            }
+        }
+
+        close( job.streamFd );     // end of stream, or the writer will fail on its next write
+        job.streamFd = -1;
+    };
+
+    auto stopJobs = [&runningJobs]()    // on error, no child may be left running or unreaped
+    {
+        for (auto & entry : runningJobs)
+        {
+            if (entry.second.streamFd >= 0)
+                close( entry.second.streamFd );
+            entry.second.streamFd = -1;
+
+            if (!entry.second.bExited)
+            {
+                kill( entry.first, SIGTERM );
+                while ((waitpid( entry.first, nullptr, 0 ) < 0) && (errno == EINTR))
+                    ;
+            }
+        }
+        runningJobs.clear();
+    };
+
+    try
+    {
+        while ((nextTask < tasks.size()) || !runningJobs.empty())
+        {
+            // start as many tasks as allowed
+            while ((nextTask < tasks.size()) && (runningJobs.size() < EvaluationJobs()) && (nFailed == 0))
+            {
+                const EvaluationTask & task = tasks[nextTask];
+
+                std::string runList;
+                for (size_t run : task.runs)
+                    runList += (runList.empty() ? "" : ", ") + std::to_string(run + 1);
+
+                LogMsgInfo( "\n+----------------------------------------------------------+" );
+                if (task.runs.size() == 1)
+                    LogMsgInfo( "|  Evaluation Run %2u                                       |", FMT_U(task.runs[0] + 1) );
+                else
+                    LogMsgInfo( "|  Evaluation Runs %hs", FMT_HS(runList.c_str()) );
+                LogMsgInfo(   "+----------------------------------------------------------+\n" );
+
+                // remove the previous log, output and marker files, and the manifests pointing into the output
+                remove( task.logFile.c_str() );
+                if (!task.bStream)
+                {
+                    remove( task.outputFile.c_str() );
+                    remove( task.markerFile.c_str() );
+
+                    for (size_t run : task.runs)
+                        remove( PointManifestFile(run).c_str() );
+                }
+
+                LogMsgInfo( "Running command:" );
+                LogMsgInfo( "%hs\n", FMT_HS(task.command.c_str()) );
+
+                int pipeFds[2] = { -1, -1 };
+                if (task.bStream)
+                {
+                    if (pipe( pipeFds ) != 0)
+                        ThrowError( std::system_error( errno, std::generic_category(), "Failed to create result pipe." ) );
+                    fcntl( pipeFds[0], F_SETFD, FD_CLOEXEC );    // keep the read ends out of all children
+                }
+
+                pid_t pid = 0;
+                try
+                {
+                    pid = StartCommand( task.command, pipeFds[1] );
+                }
+                catch (...)
+                {
+                    if (task.bStream)
+                    {
+                        close( pipeFds[0] );
+                        close( pipeFds[1] );
+                    }
+                    throw;
+                }
+
+                if (task.bStream)
+                    close( pipeFds[1] );    // only the child writes, so the pipe reaches EOF when it exits
+
+                RunningJob & job = runningJobs[pid];
+                job.task     = nextTask++;
+                job.streamFd = pipeFds[0];
+
+                if (nextTask == tasks.size())
+                    NotifyLastRunStarted();
+            }
+
+            if (runningJobs.empty())
+                break;
+
+            // wait for streamed results or for any task to complete; a task that exits after its
+            // check below wakes the next poll through the child exit pipe
+
+            std::vector<pollfd> pollFds( 1, pollfd{ childExits.ReadFd(), POLLIN, 0 } );
+            for (const auto & entry : runningJobs)
+            {
+                if (entry.second.streamFd >= 0)
+                    pollFds.push_back( pollfd{ entry.second.streamFd, POLLIN, 0 } );
+            }
+
+            if ((poll( pollFds.data(), pollFds.size(), -1 ) < 0) && (errno != EINTR))
+                ThrowError( std::system_error( errno, std::generic_category(), "Failed waiting for evaluation runs." ) );
+
+            for (const pollfd & ready : pollFds)
+            {
+                if ((ready.revents == 0) || (ready.fd == childExits.ReadFd()))
+                    continue;
+
+                for (auto & entry : runningJobs)
+                {
+                    if (entry.second.streamFd == ready.fd)
+                        readStream( entry.second );
+                }
+            }
+
+            // reap only the tasks started here, other children of this process are left alone
+
+            childExits.Drain();
+
+            for (auto & entry : runningJobs)
+            {
+                RunningJob & job = entry.second;
+                if (job.bExited)
+                    continue;
+
+                pid_t pid = 0;
+                while (((pid = waitpid( entry.first, &job.status, WNOHANG )) < 0) && (errno == EINTR))
+                    ;
+
+                if (pid < 0)
+                    ThrowError( std::system_error( errno, std::generic_category(), "Failed waiting for evaluation run." ) );
+
+                job.bExited = (pid == entry.first);
+            }
+
+            // complete the tasks that have exited and whose stream, if any, is fully read
+
+            for (auto itrJob = runningJobs.begin(); itrJob != runningJobs.end(); )
+            {
+                const RunningJob & job = itrJob->second;
+                if (!job.bExited || (job.streamFd >= 0))
+                {
+                    ++itrJob;
+                    continue;
+                }
+
+                const EvaluationTask & task = tasks[job.task];
+
+                bool bFailed = !WIFEXITED(job.status) || (WEXITSTATUS(job.status) != 0);
+                if (task.bStream && !bFailed && (job.bStreamError || !job.reader.Complete()))
+                {
+                    LogMsgError( "Incomplete matrix element stream." );
+                    bFailed = true;
+                }
+
+                if (bFailed)
+                {
+                    // let the remaining tasks finish before reporting the failure
+                    if (task.logFile.empty())
+                        LogMsgError( "Evaluation run(s) failed." );
+                    else
+                        LogMsgError( "Evaluation run(s) failed. See log file (%hs).", FMT_HS(task.logFile.c_str()) );
+                    ++nFailed;
+                }
+                else if (task.bStream)
+                {
+                    LogMsgInfo( "Evaluation run(s) completed: %llu events streamed", FMT_LLU(job.reader.NRecords()) );
+                }
+                else
+                {
+                    LogMsgInfo( "Evaluation run(s) completed: %hs", FMT_HS(task.outputFile.c_str()) );
+
+                    if (nFailed == 0)
+                    {
+                        loader.Post( [this, &task]()
+                        {
+                            AddMatrixElementsFromFile( task.outputFile.c_str(), task.runs );
+                            CreateMarkerFile( task.markerFile );
+                            WritePointManifests( task );
+                        } );
+                    }
+                }
+
+                itrJob = runningJobs.erase( itrJob );
+            }
+        }
+    }
+    catch (...)
+    {
+        stopJobs();
+        throw;
+    }
+
+    loader.Finish();
+
+    if (nFailed != 0)
+        ThrowError( "Command failed for %u evaluation task(s).", FMT_U(nFailed) );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool SherpaWeight::LoadCompletedResult( const EvaluationTask & task )
+{
+    if (!Resume() || !FileExists( task.markerFile ) || !FileExists( task.outputFile ))
+        return false;
+
+    std::string runList;
+    for (size_t run : task.runs)
+        runList += (runList.empty() ? "" : ", ") + std::to_string(run + 1);
+
+    LogMsgInfo( "Evaluation run(s) %hs already completed. Loading previous results.", FMT_HS(runList.c_str()) );
+
+    try
+    {
+        AddMatrixElementsFromFile( task.outputFile.c_str(), task.runs );
+        return true;
+    }
+    catch (const std::exception &)
+    {
+        LogMsgWarning( "Failed to load previous results (%hs). Repeating evaluation.", FMT_HS(task.outputFile.c_str()) );
+        remove( task.markerFile.c_str() );
+    }
+
+    return false;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-void SherpaWeight::ReadParametersFromFile( const char * /*filePath*/ /*= nullptr*/ )
+// A point manifest (SherpaME_<run key>.point) records where the matrix elements of a completed run
+// are stored and at which parameter values they were evaluated:
+//
+//      setup   <setup hash>
+//      file    <result file>
+//      column  <index of the run in the result file>
+//      param   <name> <value> <offset>     (one line per reweight parameter)
+
+struct PointManifest
 {
-    ParameterVector params;
+    std::string                                         setup;
+    std::string                                         file;
+    size_t                                              column = 0;
+    std::map< std::string, std::pair<double,double> >   params;     // name -> (value, offset)
+};
 
-    DefaultDataReader reader( SherpaRunPath(), m_sherpaWeightFileSection );
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool ReadPointManifest( const std::string & filePath, PointManifest & manifest )   // returns false if missing or incomplete
+{
+    std::ifstream file( filePath );
+    if (!file)
+        return false;
 
-    // Note: By default, DefaultDataReader (Data_Reader) appends the (run) section and command line parameters to the section of the file it is reading.
-    reader.SetAddCommandLine(false);  // read the raw file input
-    
-    std::vector< std::vector<std::string> > stringMatrix;
-    if (reader.MatrixFromFile( stringMatrix ))
+    manifest = PointManifest();
+
+    std::string line;
+    while (std::getline( file, line ))
     {
-        params.reserve( stringMatrix.size() );    // reserve space for all entries
-        
-        for ( const auto & row : stringMatrix )
+        std::istringstream stream( line );
+        std::string        tag;
+        stream >> tag;
+
+        if (tag == "setup")
         {
-            if (!row.size())    // skip empty rows (probably not necessary, but just for caution sake)
-                continue;
-            
-            ReweightParameter param;
-            
-            param.name = row[0];
-            
-            if (row.size() > 1)
-            {
-                try
-                {
-                    // could use ATOOLS::ToType<double>(), but that doesn't check if the conversion failed
-                    // use std::stringstream instead
-                    
-                    // TODO: try using std::stof
-                    
-                    std::stringstream stream;
-                    stream.precision(12);
-                    
-                    stream << row[1];
-                    stream >> param.offset;
-                    if (stream.fail() || !stream.eof())
-                        ThrowError( "Could not convert string to floating point value." );  // caught below
-                    
-                    if (row.size() > 2)
-                    {
-                        stream.clear();
-                        stream << row[2];
-                        stream >> param.scale;
-                        if (stream.fail() || !stream.eof())
-                            ThrowError( "Could not convert string to floating point value." );  // caught below
-                    }
-                }
-                catch (const std::exception &)
-                {
-                    ThrowError( "Failed to read expansion point/delta for reweight parameter " + param.name );
-                }
-            }
-            
-            params.push_back( std::move(param) );
+            stream >> manifest.setup;
+        }
+        else if (tag == "file")
+        {
+            std::getline( stream >> std::ws, manifest.file );
+        }
+        else if (tag == "column")
+        {
+            stream >> manifest.column;
+        }
+        else if (tag == "param")
+        {
+            std::string paramName;
+            double      value  = 0;
+            double      offset = 0;
+            stream >> paramName >> value >> offset;
+            manifest.params[paramName] = std::make_pair( value, offset );
         }
     }
-    
-    SetParameters( params );
+
+    return !manifest.setup.empty() && !manifest.file.empty();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-void SherpaWeight::SetParameters( const ParameterVector & params )
+std::string SherpaWeight::PointManifestFile( size_t run ) const
 {
-    // ensure all names are unique
+    return TemporaryPath() + "SherpaME_" + EvaluationRunKey(run) + ".point";
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void SherpaWeight::WritePointManifests( const EvaluationTask & task ) const
+{
+    for (size_t column = 0; column < task.runs.size(); ++column)
     {
-        std::set<std::string> duplicateNames;
+        size_t      run          = task.runs[column];
+        std::string manifestFile = PointManifestFile(run);
 
-        for (auto itr1 = params.cbegin(), end = params.cend(); itr1 != end; ++itr1)
+        FILE * pFile = fopen( manifestFile.c_str(), "w" );
+        if (!pFile)
         {
-            for (auto itr2 = itr1 + 1; itr2 != end; ++itr2)
-            {
-                if (itr1->name == itr2->name)
-                {
-                    duplicateNames.insert( itr1->name );
-                    break;
-                }
-            }
+            LogMsgWarning( "Failed to create point manifest (%hs).", FMT_HS(manifestFile.c_str()) );
+            continue;
         }
 
-        if (!duplicateNames.empty())
+        fprintf( pFile, "setup\t%s\n",   HashToString( EvaluationSetupHash() ).c_str() );
+        fprintf( pFile, "file\t%s\n",    task.outputFile.c_str() );
+        fprintf( pFile, "column\t%u\n",  FMT_U(column) );
+
+        for (size_t i = 0; i < m_parameters.size(); ++i)
         {
-            std::string strDup;
-            for (const std::string & s : duplicateNames)
-            {
-                if (!strDup.empty()) strDup += ", ";
-                strDup += s;
-            }
-            
-            ThrowError( "Duplicate reweight parameters: " + strDup );
+            fprintf( pFile, "param\t%s\t%.17E\t%.17E\n", m_parameters[i].name.c_str(),
+                     FMT_F(m_evalMatrix[run][i]), FMT_F(m_parameters[i].offset) );
         }
+
+        if (fclose( pFile ) != 0)
+            LogMsgWarning( "Failed to write point manifest (%hs).", FMT_HS(manifestFile.c_str()) );
     }
+}
 
-    // validate parameters with model
-    m_pModel->ValidateParameters(params);
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Resume a single run from its point manifest, which is written once the results of its task are
+// loaded, wherever the run was placed among the runs of that task.
 
-    // set the parameters
-    m_parameters = params;
+bool SherpaWeight::LoadCompletedRun( size_t run )
+{
+    PointManifest manifest;
+    if (!Resume() || !ReadPointManifest( PointManifestFile(run), manifest ) || !FileExists( manifest.file ))
+        return false;
 
-    LogMsgInfo( "Reweight parameters (" + std::to_string(m_parameters.size()) + "):" );
-    for (const auto & p : m_parameters)
-        LogMsgInfo( "  " + p.name );
-    LogMsgInfo( "" );
+    if (manifest.setup != HashToString( EvaluationSetupHash() ))
+        return false;
 
-    // calculate bilinear matrices
-    
-    GetBilinearMatrices( m_parameters, m_evalMatrix, m_invCoefMatrix, m_coefNames );
+    LogMsgInfo( "Evaluation run %u already completed. Loading previous results.", FMT_U(run + 1) );
 
-    LogMsgInfo( "Reweight coefficients (" + std::to_string(m_coefNames.size()) + "):" );
-    for (const auto & n : m_coefNames)
-        LogMsgInfo( "  " + n );
-    LogMsgInfo( "" );
+    std::vector<size_t> columns( manifest.column + 1, SkipColumn );
+    columns[manifest.column] = run;
 
-    m_matrixElements.clear();  // cleanup any previous run
+    try
+    {
+        AddMatrixElementsFromFile( manifest.file.c_str(), columns );
+        return true;
+    }
+    catch (const std::exception &)
+    {
+        LogMsgWarning( "Failed to load previous results (%hs). Repeating evaluation.", FMT_HS(manifest.file.c_str()) );
+        remove( PointManifestFile(run).c_str() );
+    }
+
+    return false;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-void SherpaWeight::EvaluateEvents()
+// Match the runs against the point manifests of earlier configurations of the same sample.
+// A parameter missing from either side is taken to be at its offset (expansion point), where it
+// must leave the model unchanged. This lets the runs of a smaller parameter set be reused after
+// adding parameters, as GetBilinearMatrices lays out the points in the same way.
+
+void SherpaWeight::ReuseStoredPoints( std::vector<size_t> & runs )
 {
-    size_t nEvaluations = NEvaluations();
-    
-    m_matrixElements.clear();  // cleanup any previous run
+    const std::string setup = HashToString( EvaluationSetupHash() );
 
-    if (nEvaluations == 0)
-        return;
+    // read all manifests of this setup
+
+    std::vector<PointManifest> stored;
 
-    // setup the base SherpaME command
+    if (DIR * pDir = opendir( TemporaryPath().c_str() ))
+    {
+        while (struct dirent * pEntry = readdir( pDir ))
+        {
+            std::string name = pEntry->d_name;
+            if ((name.size() < 6) || (name.compare( name.size() - 6, 6, ".point" ) != 0))
+                continue;
 
-    std::string outputFile  = TemporaryPath()      + "SherpaME_output.root";
-    std::string baseCommand = "\"" + ApplicationRunPath() + "SherpaME\"";
+            PointManifest point;
+            if (ReadPointManifest( TemporaryPath() + name, point ) && (point.setup == setup))
+                stored.push_back( std::move(point) );
+        }
 
-    baseCommand += " \"" + m_eventFileName + "\"";  // input  file
-    baseCommand += " \"" + outputFile      + "\"";  // output file
+        closedir( pDir );
+    }
 
-    // extra sherpa arguments
-    for (size_t i = 1; i < m_argv.size(); ++i)
-        baseCommand += std::string(" \"") + m_argv[i] + "\"";
+    if (stored.empty())
+        return;
 
-    baseCommand += " OUTPUT=2";     // override output level
+    // load the matching points
 
-    // run evaluations
-    
-    for (size_t run = 0; run < nEvaluations; ++run)
+    std::vector<size_t> remaining;
+    size_t              nReused = 0;
+
+    for (size_t run : runs)
     {
-        LogMsgInfo( "\n+----------------------------------------------------------+" );
-        LogMsgInfo(   "|  Evaluation Run %2u                                       |", FMT_U(run + 1) );
-        LogMsgInfo(   "+----------------------------------------------------------+\n" );
+        const PointManifest * pMatch = nullptr;
 
-        // setup the run
+        for (const PointManifest & point : stored)
+        {
+            bool bMatch = true;
 
-        char runString[20];
-        sprintf( runString, "%02u", FMT_U(run + 1) );
+            for (size_t i = 0; bMatch && (i < m_parameters.size()); ++i)
+            {
+                auto itrFind = point.params.find( m_parameters[i].name );
+                double storedValue = (itrFind != point.params.end()) ? itrFind->second.first : m_parameters[i].offset;
+                bMatch = (storedValue == m_evalMatrix[run][i]);
+            }
 
-        std::string modelArgs = m_pModel->CommandLineArgs( m_parameters, m_evalMatrix[run] );
+            for (auto itr = point.params.cbegin(); bMatch && (itr != point.params.cend()); ++itr)
+            {
+                bool bCurrent = std::any_of( m_parameters.cbegin(), m_parameters.cend(),
+                                             [itr]( const ReweightParameter & p ) { return p.name == itr->first; } );
+                if (!bCurrent)
+                    bMatch = (itr->second.first == itr->second.second);
+            }
 
-        std::string logFile   = TemporaryPath() + "SherpaME_" + runString + ".log";
+            if (bMatch)
+            {
+                pMatch = &point;
+                break;
+            }
+        }
 
-        // remove the previous log file
-        remove( logFile.c_str() );
+        if (pMatch)
+        {
+            std::vector<size_t> columns( pMatch->column + 1, SkipColumn );
+            columns[pMatch->column] = run;
 
-        // build the command line
-        std::string command = baseCommand;
+            try
+            {
+                AddMatrixElementsFromFile( pMatch->file.c_str(), columns );
+                LogMsgInfo( "Evaluation run %u reuses stored point (%hs).", FMT_U(run + 1), FMT_HS(pMatch->file.c_str()) );
+                ++nReused;
+                continue;
+            }
+            catch (const std::exception &)
+            {
+                LogMsgWarning( "Failed to load stored point (%hs). Evaluating run %u.", FMT_HS(pMatch->file.c_str()), FMT_U(run + 1) );
+            }
+        }
 
-        command += " \"LOG_FILE=" + logFile + "\"";
-        command += " " + modelArgs;
+        remaining.push_back( run );
+    }
 
-        LogMsgInfo( "Running command:" );
-        LogMsgInfo( "%hs\n", FMT_HS(command.c_str()) );
+    LogMsgInfo( "Reused %u of %u evaluation runs from stored points.", FMT_U(nReused), FMT_U(runs.size()) );
 
-        int result = system( command.c_str() );
-        if (result != 0)
-            ThrowError( "Command failed. See log file (" + logFile + ")." );
-        
-        AddMatrixElementsFromFile( outputFile.c_str() );
-    }
-    
-    // validate matrix elements
+    runs.swap( remaining );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void SherpaWeight::GatherMatrixElements()
+{
+    // each rank sends its evaluated matrix elements to rank 0 in chunks, ending with an empty chunk
+
+    const int       tag         = 1;
+    const size_t    chunkSize   = 1 << 16;  // records
+
+    std::vector<MatrixElementRecord> records;
+    records.reserve( chunkSize );
+
+    if (MPIRank() != 0)
     {
-        EventMatrixElementMap::iterator itr = m_matrixElements.begin();
-        EventMatrixElementMap::iterator end = m_matrixElements.end();
-        while (itr != end)
+        auto sendChunk = [&]()
+        {
+            MPI::COMM_WORLD.Send( records.data(), static_cast<int>(records.size() * sizeof(MatrixElementRecord)), MPI::BYTE, 0, tag );
+            records.clear();
+        };
+
+        for (const auto & entry : m_matrixElements)
         {
-            if (itr->second.size() != nEvaluations)
+            for (size_t run = 0; run < entry.second.me.size(); ++run)
             {
-                LogMsgWarning( "Discarding event %i. Evaluations: %u, require: %u.", FMT_I(itr->first), FMT_U(itr->second.size()), FMT_U(nEvaluations) );
-                itr = m_matrixElements.erase(itr);  // returned itr is next itr in map
-                continue;
+                if (!entry.second.evaluated[run])
+                    continue;   // not evaluated on this rank
+
+                records.push_back( { entry.first, static_cast<uint32_t>(run), entry.second.me[run] } );
+
+                if (records.size() == chunkSize)
+                    sendChunk();
             }
-            ++itr;
         }
+
+        if (!records.empty())
+            sendChunk();
+        sendChunk();    // end of transfer
+
+        m_matrixElements.clear();
+        return;
+    }
+
+    records.resize( chunkSize );
+
+    for (int rank = 1; rank < MPISize(); ++rank)
+    {
+        size_t nReceived = 0;
+
+        for (;;)
+        {
+            MPI::Status status;
+            MPI::COMM_WORLD.Recv( records.data(), static_cast<int>(chunkSize * sizeof(MatrixElementRecord)), MPI::BYTE, rank, tag, status );
+
+            size_t nRecords = status.Get_count( MPI::BYTE ) / sizeof(MatrixElementRecord);
+            if (nRecords == 0)
+                break;
+
+            for (size_t i = 0; i < nRecords; ++i)
+                AddMatrixElement( records[i].eventId, records[i].run, records[i].me );
+
+            nReceived += nRecords;
+        }
+
+        LogMsgInfo( "Received %llu matrix elements from MPI rank %i.", FMT_LLU(nReceived), FMT_I(rank) );
     }
 }
 
@@ -364,38 +1641,47 @@ const SherpaWeight::DoubleVector & SherpaWeight::MatrixElements( int32_t eventId
         return empty;
     }
     
-    return itrFind->second;
+    return itrFind->second.me;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 SherpaWeight::DoubleVector SherpaWeight::CoefficientValues( int32_t eventId ) const
 {
-    DoubleVector coefs;
-    
+    DoubleVector coefs( m_invCoefMatrix.size() );
+
+    if (!CoefficientValues( eventId, coefs.data() ))
+        coefs.clear();
+
+    return coefs;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool SherpaWeight::CoefficientValues( int32_t eventId, double * pCoefs ) const
+{
     const DoubleVector & matrixElements = MatrixElements(eventId);
 
-    if (matrixElements.size() == m_invCoefMatrix.size())
+    if (matrixElements.empty() || (matrixElements.size() != m_invCoefMatrix.size()))
+        return false;
+
+    size_t nCoefs = m_invCoefMatrix.size();
+
+    for (size_t i = 0; i < nCoefs; ++i)
     {
-        size_t nCoefs = m_invCoefMatrix.size();
-        
-        coefs.resize(nCoefs);
-        
-        for (size_t i = 0; i < nCoefs; ++i)
-        {
-            double & coef = coefs[i];
+        double coef = 0;
 
-            for (size_t j = 0; j < nCoefs; ++j)
-            {
-                coef += m_invCoefMatrix[i][j] * matrixElements[j];
-            }
+        for (size_t j = 0; j < nCoefs; ++j)
+        {
+            coef += m_invCoefMatrix[i][j] * matrixElements[j];
         }
+
+        pCoefs[i] = coef;
     }
 
-    return coefs;
+    return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-void SherpaWeight::AddMatrixElementsFromFile( const char * filePath )
+void SherpaWeight::AddMatrixElementsFromFile( const char * filePath, const std::vector<size_t> & runs )
 {
     // open input file
     
@@ -412,9 +1698,24 @@ void SherpaWeight::AddMatrixElementsFromFile( const char * filePath )
     upInputFile->GetObject( "SherpaME", pInputTree );
     if (!pInputTree)
         ThrowError( "Failed to load input tree." );
+
+    // a multi-point file holds the matrix elements of all its points in each entry
     
-    MERootEvent inputEvent;
-    inputEvent.SetInputTree( pInputTree );
+    const bool bMultiPoint = (pInputTree->GetBranch( "npoint" ) != nullptr);
+
+    if (!bMultiPoint && ((runs.size() != 1) || (runs[0] == SkipColumn)))
+        ThrowError( "ME root file holds a single point, expected " + std::to_string(runs.size()) + " (" + std::string(filePath) + ")" );
+
+    MERootEvent                         inputEvent;
+    std::unique_ptr<MEPointsRootEvent>  upPointsEvent;
+
+    if (bMultiPoint)
+    {
+        upPointsEvent.reset( new MEPointsRootEvent );
+        upPointsEvent->SetInputTree( pInputTree );
+    }
+    else
+        inputEvent.SetInputTree( pInputTree );
     
     // loop through and process each input event
     
@@ -428,15 +1729,41 @@ void SherpaWeight::AddMatrixElementsFromFile( const char * filePath )
         if (pInputTree->GetEntry(iEntry) < 0)
             ThrowError( "GetEntry failed on entry " + std::to_string(iEntry) );
 
-        AddMatrixElement( inputEvent.id, inputEvent.me );
+        if (!bMultiPoint)
+        {
+            AddMatrixElement( inputEvent.id, runs[0], inputEvent.me );
+            continue;
+        }
+
+        if (static_cast<size_t>(upPointsEvent->npoint) < runs.size())
+            ThrowError( "ME root file entry " + std::to_string(iEntry) + " holds " + std::to_string(upPointsEvent->npoint) +
+                        " points, expected " + std::to_string(runs.size()) );
+
+        for (size_t i = 0; i < runs.size(); ++i)
+        {
+            if (runs[i] != SkipColumn)
+                AddMatrixElement( upPointsEvent->id, runs[i], upPointsEvent->me[i] );
+        }
     }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-void SherpaWeight::AddMatrixElement( int32_t eventId, double me )
+void SherpaWeight::AddMatrixElement( int32_t eventId, size_t run, double me )
 {
-    DoubleVector & vector = m_matrixElements[eventId];
-    vector.push_back( me );
+    EventMatrixElements & entry = m_matrixElements[eventId];
+
+    // runs can complete in any order, so store by run index and mark each run as evaluated
+    if (entry.me.empty())
+    {
+        entry.me.resize(        NEvaluations(), 0.0   );
+        entry.evaluated.resize( NEvaluations(), false );
+    }
+
+    if (run >= entry.me.size())
+        ThrowError( "AddMatrixElement: invalid evaluation run " + std::to_string(run + 1) );
+
+    entry.me[run]        = me;
+    entry.evaluated[run] = true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -692,6 +2019,26 @@ void SherpaWeight::GetBilinearMatrices( const ParameterVector & parameters,
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// class SherpaWeight::ModelInterface
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+std::string SherpaWeight::ModelInterface::CommandLineArgs( const ParameterVector & params, const DoubleVector & paramValues,
+                                                           const std::string & workPath )
+{
+    std::string cmdArgs;
+
+    for (const std::string & arg : SherpaArgs( params, paramValues, workPath ))
+    {
+        if (!cmdArgs.empty()) cmdArgs += " ";
+
+        cmdArgs += "\"" + arg + "\"";
+    }
+
+    return cmdArgs;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // class SherpaWeight::SM_AGC_Model
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -757,12 +2104,13 @@ void SherpaWeight::SM_AGC_Model::ValidateParameters( const ParameterVector & par
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-std::string SherpaWeight::SM_AGC_Model::CommandLineArgs( const ParameterVector & params, const DoubleVector & paramValues )
+SherpaWeight::StringVector SherpaWeight::SM_AGC_Model::SherpaArgs( const ParameterVector & params, const DoubleVector & paramValues,
+                                                                   const std::string & /*workPath*/ )
 {
-    std::string cmdArgs;
+    StringVector args;
 
     if (params.size() != paramValues.size())
-        ThrowError( std::invalid_argument( "CommandLineArgs: mismatch in size of parameter and value vectors." ) );
+        ThrowError( std::invalid_argument( "SherpaArgs: mismatch in size of parameter and value vectors." ) );
 
     char buffer[40];
 
@@ -772,14 +2120,10 @@ std::string SherpaWeight::SM_AGC_Model::CommandLineArgs( const ParameterVector &
         double value = *itrValue++;
         sprintf( buffer, "%.13E", FMT_F(value) );
 
-        if (!cmdArgs.empty()) cmdArgs += " ";
-
-        cmdArgs += p.name;
-        cmdArgs += "=";
-        cmdArgs += buffer;
+        args.push_back( p.name + "=" + buffer );
     }
 
-    return cmdArgs;
+    return args;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -821,16 +2165,22 @@ void SherpaWeight::FeynRulesModel::ValidateParameters( const ParameterVector & /
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-std::string SherpaWeight::FeynRulesModel::CommandLineArgs( const ParameterVector & params, const DoubleVector & paramValues )
+SherpaWeight::StringVector SherpaWeight::FeynRulesModel::InputFiles() const
+{
+    return StringVector( 1, m_pParent->SherpaRunPath() + m_sourceParamCardFile );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+SherpaWeight::StringVector SherpaWeight::FeynRulesModel::SherpaArgs( const ParameterVector & params, const DoubleVector & paramValues,
+                                                                     const std::string & workPath )
 {
     std::string srcFilePath = m_pParent->SherpaRunPath() + m_sourceParamCardFile;
-    std::string dstFilePath = m_pParent->TemporaryPath() + "param_card_me.dat";
+    std::string dstFilePath = workPath + "param_card_me.dat";
         
     // create param_card with new parameter values
     CreateFeynRulesParamCard( srcFilePath, dstFilePath, params, paramValues );
 
-    std::string cmdArgs = "\"FR_PARAMCARD=" + dstFilePath + "\"";
-    return cmdArgs;
+    return StringVector( 1, "FR_PARAMCARD=" + dstFilePath );
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1025,16 +2375,22 @@ void SherpaWeight::UFOModel::ValidateParameters( const ParameterVector & params
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-std::string SherpaWeight::UFOModel::CommandLineArgs( const ParameterVector & params, const DoubleVector & paramValues )
+SherpaWeight::StringVector SherpaWeight::UFOModel::InputFiles() const
+{
+    return StringVector( 1, m_pParent->SherpaRunPath() + m_sourceParamCardFile );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+SherpaWeight::StringVector SherpaWeight::UFOModel::SherpaArgs( const ParameterVector & params, const DoubleVector & paramValues,
+                                                               const std::string & workPath )
 {
     std::string srcFilePath = m_pParent->SherpaRunPath() + m_sourceParamCardFile;
-    std::string dstFilePath = m_pParent->TemporaryPath() + "param_card_me.dat";
+    std::string dstFilePath = workPath + "param_card_me.dat";
 
     // create param_card with new parameter values
     CreateUFOParamCard( srcFilePath, dstFilePath, m_bUseRunCard, params, paramValues );
 
-    std::string cmdArgs = "\"UFO_PARAM_CARD=" + dstFilePath + "\"";
-    return cmdArgs;
+    return StringVector( 1, "UFO_PARAM_CARD=" + dstFilePath );
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
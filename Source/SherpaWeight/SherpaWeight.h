@@ -7,6 +7,8 @@
 
 #include "common.h"
 
+#include <functional>
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // forward declarations
 
@@ -48,7 +50,24 @@ public:     ////// public types //////
 
         virtual void ValidateParameters( const ParameterVector & params ) = 0;
 
-        virtual std::string CommandLineArgs( const ParameterVector & params, const DoubleVector & paramValues )  = 0;
+        // Sherpa arguments selecting the parameter values, unquoted
+        // workPath is a directory private to the evaluation run, for any files the model needs to create
+        virtual StringVector SherpaArgs( const ParameterVector & params, const DoubleVector & paramValues,
+                                         const std::string & workPath ) = 0;
+
+        // files besides the run file that the evaluation runs read, for identifying the setup of a run
+        virtual StringVector InputFiles() const { return StringVector(); }
+
+        // SherpaArgs quoted for a shell command line
+        std::string CommandLineArgs( const ParameterVector & params, const DoubleVector & paramValues,
+                                     const std::string & workPath );
+    };
+
+    enum class EvaluationEngine
+    {
+        SherpaME,       // run the SherpaME program for each evaluation
+        MultiPoint,     // run the SherpaME program once per job, evaluating several parameter points in one pass
+        Server          // send each evaluation to a running SherpaME server (SherpaME --server)
     };
 
     class SM_AGC_Model;
@@ -66,6 +85,30 @@ public:     ////// public methods //////
     const std::string & ApplicationRunPath() const throw()  { return m_appRunPath;    }
     const std::string & SherpaRunPath()      const throw()  { return m_sherpaRunPath; }
     const std::string & TemporaryPath()      const throw()  { return m_tmpPath;       }
+
+    size_t EvaluationJobs()  const throw()                      { return m_nJobs; }  // maximum concurrent evaluation runs
+    void   SetEvaluationJobs( size_t nJobs );                                         // 0 = number of online processors
+
+    int MPIRank() const throw()                                 { return m_mpiRank; }  // evaluation runs are split across MPI ranks,
+    int MPISize() const throw()                                 { return m_mpiSize; }  // rank 0 gathers all matrix elements
+
+    bool Resume() const throw()                                 { return m_bResume; }  // reuse results of completed runs
+    void SetResume( bool bResume ) throw()                      { m_bResume = bResume; }
+
+    bool ReusePoints() const throw()                            { return m_bReusePoints; }  // reuse stored results of matching parameter
+    void SetReusePoints( bool bReuse ) throw()                  { m_bReusePoints = bReuse; } // points of earlier configurations
+
+    bool StreamResults() const throw()                          { return m_bStreamResults; }  // SherpaME runs send results over a pipe
+    void SetStreamResults( bool bStream ) throw()               { m_bStreamResults = bStream; } // instead of root files (no resume)
+
+    const std::string & MEStorePath() const throw()             { return m_meStorePath; }  // persistent ME store, empty if none
+    void                SetMEStorePath( const std::string & path );
+
+    const StringVector & ServerSockets() const throw()          { return m_serverSockets; }  // SherpaME servers of the Server engine
+    void                 SetServerSockets( const std::string & socketList );              // comma separated socket paths
+
+    EvaluationEngine Engine() const throw()                     { return m_engine; }
+    void             SetEngine( EvaluationEngine engine ) throw()   { m_engine = engine; }
     
     void ReadParametersFromFile( const char * filePath = nullptr );  // filePath can contain section definition
     void SetParameters( const ParameterVector & params );
@@ -79,10 +122,12 @@ public:     ////// public methods //////
     const DoubleMatrix &     InverseCoefficientMatrix() const   { return m_invCoefMatrix; }
     const StringVector &     CoefficientNames()         const   { return m_coefNames;     }
 
-    void EvaluateEvents();
+    // onLastRunStarted is called once all evaluation runs have started, to overlap later work with the last runs
+    void EvaluateEvents( const std::function<void()> & onLastRunStarted = nullptr );
 
     const DoubleVector & MatrixElements(    int32_t eventId ) const;
     DoubleVector         CoefficientValues( int32_t eventId ) const;
+    bool                 CoefficientValues( int32_t eventId, double * pCoefs ) const;   // fills NCoefficients() values; false if no matrix elements
 
     
     static void GetBilinearMatrices( const ParameterVector & parameters, DoubleMatrix & evalMatrix,
@@ -91,12 +136,46 @@ public:     ////// public methods //////
 
 private:    ////// private types //////
 
-    typedef std::map< int32_t, DoubleVector > EventMatrixElementMap;
+    struct EventMatrixElements
+    {
+        DoubleVector        me;         // by evaluation run
+        std::vector<bool>   evaluated;  // by evaluation run; a matrix element may itself be NaN
+    };
+    typedef std::map< int32_t, EventMatrixElements > EventMatrixElementMap;
+
+    struct EvaluationTask;
+    typedef std::vector<EvaluationTask>     TaskVector;
 
 private:    ////// private methods //////
 
-    void AddMatrixElementsFromFile( const char * filePath );
-    void AddMatrixElement( int32_t eventId, double me );
+    std::string EvaluationRunString( size_t run ) const;
+    std::string EvaluationWorkPath(  size_t run ) const;
+    uint64_t    EvaluationSetupHash()            const;     // hash of input file, sherpa arguments and run and model files
+    std::string EvaluationRunKey(    size_t run ) const;     // hash of setup and parameter point
+
+    void EvaluateRunsSherpaME(    const std::vector<size_t> & runs );
+    void EvaluateRunsMultiPoint(  const std::vector<size_t> & runs );
+    void EvaluateRunsServer(      const std::vector<size_t> & runs );
+
+    std::string SherpaMECommand( const std::string & outputFile, const std::string & options,
+                                 const std::string & logFile ) const;
+    void RunEvaluationTasks( const TaskVector & tasks );
+
+    bool LoadCompletedResult( const EvaluationTask & task );   // returns true if results of a previous job were loaded
+    bool LoadCompletedRun( size_t run );                       // returns true if the run was loaded from its point manifest
+    std::string PointManifestFile( size_t run ) const;
+    void WritePointManifests( const EvaluationTask & task ) const;
+    static void SetStreamOutput( EvaluationTask & task );     // results of the task are streamed over a pipe
+    void ReuseStoredPoints( std::vector<size_t> & runs );      // removes runs loaded from matching stored points
+
+    void NotifyLastRunStarted();
+
+    void GatherMatrixElements();
+
+    static const size_t SkipColumn = static_cast<size_t>(-1);
+
+    void AddMatrixElementsFromFile( const char * filePath, const std::vector<size_t> & runs );     // runs in the order of the file points, or SkipColumn
+    void AddMatrixElement( int32_t eventId, size_t run, double me );
     
 private:    ////// private data //////
 
@@ -104,8 +183,18 @@ private:    ////// private data //////
     std::vector<const char *>           m_argv;
     std::string                         m_appRunPath;
     std::string                         m_sherpaRunPath;
+    std::string                         m_sherpaRunFile;    // without any section
     std::string                         m_tmpPath;
     std::string                         m_sherpaWeightFileSection;
+    size_t                              m_nJobs     = 1;
+    EvaluationEngine                    m_engine    = EvaluationEngine::SherpaME;
+    int                                 m_mpiRank   = 0;
+    int                                 m_mpiSize   = 1;
+    bool                                m_bResume   = true;
+    bool                                m_bReusePoints = false;
+    bool                                m_bStreamResults = false;
+    std::string                         m_meStorePath;
+    StringVector                        m_serverSockets;
 
     ModelInterface *                    m_pModel    = nullptr;
     bool                                m_bOwnModel = true;
@@ -116,8 +205,11 @@ private:    ////// private data //////
     StringVector                        m_coefNames;
 
     std::string                         m_eventFileName;
+    uint64_t                            m_eventFileHash = HashSeed;     // contents of the input file
     EventMatrixElementMap               m_matrixElements;
 
+    std::function<void()>               m_onLastRunStarted;     // set during EvaluateEvents
+
 private:
     SherpaWeight(const SherpaWeight &)              = delete;   // disable copy constructor
     SherpaWeight & operator=(const SherpaWeight &)  = delete;   // disable assignment operator
@@ -139,7 +231,8 @@ public:  // ModelInterface overrides
 
     virtual void ValidateParameters( const ParameterVector & params );
 
-    virtual std::string CommandLineArgs( const ParameterVector & params, const DoubleVector & paramValues );
+    virtual StringVector SherpaArgs( const ParameterVector & params, const DoubleVector & paramValues,
+                                     const std::string & workPath );
 
 private:
     SherpaWeight *  m_pParent = nullptr;
@@ -165,7 +258,10 @@ public:  // ModelInterface overrides
 
     virtual void ValidateParameters( const ParameterVector & params );
 
-    virtual std::string CommandLineArgs( const ParameterVector & params, const DoubleVector & paramValues );
+    virtual StringVector SherpaArgs( const ParameterVector & params, const DoubleVector & paramValues,
+                                     const std::string & workPath );
+
+    virtual StringVector InputFiles() const;
 
 protected:
     static void CreateFeynRulesParamCard( const std::string & srcFilePath,    const std::string & dstFilePath,
@@ -196,7 +292,10 @@ public:  // ModelInterface overrides
 
     virtual void ValidateParameters( const ParameterVector & params );
 
-    virtual std::string CommandLineArgs( const ParameterVector & params, const DoubleVector & paramValues );
+    virtual StringVector SherpaArgs( const ParameterVector & params, const DoubleVector & paramValues,
+                                     const std::string & workPath );
+
+    virtual StringVector InputFiles() const;
 
 protected:
     static void CreateUFOParamCard( const std::string & srcFilePath,    const std::string & dstFilePath, bool bUseUfoSection,
@@ -10,6 +10,11 @@
 
 #include "common.h"
 
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Sherpa and Root include files
 
@@ -23,6 +28,127 @@
 // OpenMPI includes
 #include <mpi.h>
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// class EventPrefetcher
+//
+// Reads the events of an input file on a background thread into a bounded queue, so reading
+// (and decompressing) the input overlaps with the last evaluation runs and with writing the output.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class EventPrefetcher
+{
+public:
+    EventPrefetcher( const std::string & fileName, size_t maxQueued )
+        : m_maxQueued( std::max( maxQueued, size_t(1) ) )
+    {
+        m_inputFile.Open( fileName, EventFileInterface::OpenMode::Read );
+        m_thread = std::thread( &EventPrefetcher::Process, this );
+    }
+
+    ~EventPrefetcher() throw()
+    {
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            m_bStop = true;
+        }
+        m_condition.notify_all();
+
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+    uint64_t Count() const                      { return m_inputFile.Count(); }
+
+    EventFileEvent::UniquePtr Next()            // returns null after the last event; rethrows read errors
+    {
+        std::unique_lock<std::mutex> lock( m_mutex );
+        m_condition.wait( lock, [this]() { return !m_queue.empty() || m_bEnd; } );
+
+        if (m_queue.empty())
+        {
+            if (m_error)
+                std::rethrow_exception( m_error );
+            return nullptr;
+        }
+
+        EventFileEvent::UniquePtr upEvent = std::move( m_queue.front() );
+        m_queue.pop();
+
+        lock.unlock();
+        m_condition.notify_all();
+
+        return upEvent;
+    }
+
+    void Recycle( EventFileEvent::UniquePtr upEvent )   // return an event for reuse
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        m_free.push_back( std::move(upEvent) );
+    }
+
+private:
+    void Process()
+    {
+        try
+        {
+            for (;;)
+            {
+                EventFileEvent::UniquePtr upEvent;
+                {
+                    std::unique_lock<std::mutex> lock( m_mutex );
+                    m_condition.wait( lock, [this]() { return (m_queue.size() < m_maxQueued) || m_bStop; } );
+
+                    if (m_bStop)
+                        return;
+
+                    if (!m_free.empty())
+                    {
+                        upEvent = std::move( m_free.back() );
+                        m_free.pop_back();
+                    }
+                }
+
+                if (!upEvent)
+                    upEvent = m_inputFile.AllocateEvent();
+
+                if (!m_inputFile.ReadEvent( *upEvent ))
+                    break;
+
+                {
+                    std::lock_guard<std::mutex> lock( m_mutex );
+                    m_queue.push( std::move(upEvent) );
+                }
+                m_condition.notify_all();
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            m_error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            m_bEnd = true;
+        }
+        m_condition.notify_all();
+    }
+
+private:
+    //SherpaRootEventFile                     m_inputFile;
+    HepMCEventFile                          m_inputFile;
+    const size_t                            m_maxQueued;
+
+    std::mutex                              m_mutex;
+    std::condition_variable                 m_condition;
+    std::queue<EventFileEvent::UniquePtr>   m_queue;
+    std::vector<EventFileEvent::UniquePtr>  m_free;
+    bool                                    m_bStop     = false;
+    bool                                    m_bEnd      = false;
+    std::exception_ptr                      m_error;
+    std::thread                             m_thread;
+};
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // class SherpaWeight
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -39,6 +165,7 @@ SherpaWeightProgram::SherpaWeightProgram()
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 SherpaWeightProgram::~SherpaWeightProgram() throw()
 {
+    m_upPrefetcher.reset();
     m_upSherpaWeight.reset();
 
     // finalize MPI (required if sherpa was compiled with --enable-mpi configure option)
@@ -93,8 +220,17 @@ int SherpaWeightProgram::Run( const RunParameters & param )
             return EXIT_SUCCESS;
         }
         
-        // evaluate the events
-        m_upSherpaWeight->EvaluateEvents();
+        // evaluate the events, starting to read the input for SaveCoefficients while the last runs finish
+        if (m_upSherpaWeight->MPIRank() == 0)
+            m_upSherpaWeight->EvaluateEvents( [this, &param]() { StartInputPrefetch( param ); } );
+        else
+            m_upSherpaWeight->EvaluateEvents();
+
+        if (m_upSherpaWeight->MPIRank() != 0)
+        {
+            LogMsgInfo( "\nMatrix elements sent to MPI rank 0. Done." );
+            return EXIT_SUCCESS;    // rank 0 saves the coefficients
+        }
         
         SaveCoefficients( param );
 
@@ -113,6 +249,17 @@ int SherpaWeightProgram::Run( const RunParameters & param )
     return EXIT_FAILURE;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void SherpaWeightProgram::StartInputPrefetch( const RunParameters & param )
+{
+    if (m_upPrefetcher)
+        return;
+
+    LogMsgInfo( "Prefetching input file: %hs", FMT_HS(param.inputRootFileName.c_str()) );
+
+    m_upPrefetcher.reset( new EventPrefetcher( param.inputRootFileName, 1000 ) );
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 void SherpaWeightProgram::SaveCoefficients( const RunParameters & param )
 {
@@ -120,12 +267,12 @@ void SherpaWeightProgram::SaveCoefficients( const RunParameters & param )
     LogMsgInfo(   "|  Calculating and Saving Coefficients                     |"   );
     LogMsgInfo(   "+----------------------------------------------------------+\n" );
 
-    // open input file
+    // open input file (normally already opened by the prefetch started during the evaluation)
 
     LogMsgInfo( "Input file : %hs", FMT_HS(param.inputRootFileName.c_str()) );
-    //SherpaRootEventFile inputFile;
-    HepMCEventFile inputFile;
-    inputFile.Open( param.inputRootFileName, EventFileInterface::OpenMode::Read );
+    StartInputPrefetch( param );
+
+    std::unique_ptr<EventPrefetcher> upPrefetcher( std::move(m_upPrefetcher) );
 
     // open output file
 
@@ -141,15 +288,10 @@ void SherpaWeightProgram::SaveCoefficients( const RunParameters & param )
 
     outputFile.SetCoefficientNames( coefNames );
 
-    // create event containers
-
-    EventFileEvent::UniquePtr   upCurrentEvent  = inputFile.AllocateEvent();
-    EventFileEvent &            currentEvent    = *upCurrentEvent;
-
     // loop through and process each input event
 
     uint64_t    iEvent          = 1;
-    uint64_t    nEvents         = inputFile.Count();
+    uint64_t    nEvents         = upPrefetcher->Count();
     uint64_t    logFrequency    = 1;
     uint32_t    logCount        = 0;
 
@@ -160,19 +302,17 @@ void SherpaWeightProgram::SaveCoefficients( const RunParameters & param )
 
     time_t timeStartProcess = time(nullptr);
 
-    for ( ; inputFile.ReadEvent( currentEvent ); ++iEvent)
+    SherpaWeight::DoubleVector coefs( nCoefs );     // reused for every event
+
+    for (EventFileEvent::UniquePtr upCurrentEvent; (upCurrentEvent = upPrefetcher->Next()); ++iEvent)
     {
+        EventFileEvent & currentEvent = *upCurrentEvent;
+
         {
-            SherpaWeight::DoubleVector coefs = m_upSherpaWeight->CoefficientValues( currentEvent.eventId );
-            if (coefs.empty())
+            if (!m_upSherpaWeight->CoefficientValues( currentEvent.eventId, coefs.data() ))
             {
                 LogMsgWarning( "No coefficients for event %llu (id %i).", FMT_LLU(iEvent), FMT_I(currentEvent.eventId) );
-            }
-
-            if (coefs.size() != nCoefs)
-            {
                 LogMsgWarning( "Missing coefficients for event %llu (id %i). Setting all to zero.", FMT_LLU(iEvent), FMT_I(currentEvent.eventId) );
-                coefs.resize(nCoefs);
                 std::fill( coefs.begin(), coefs.end(), 0.0 );
             }
 
@@ -197,10 +337,12 @@ void SherpaWeightProgram::SaveCoefficients( const RunParameters & param )
                 LogMsgInfo( "" );
             }
 
-            currentEvent.SetCoefficients( coefs );
+            currentEvent.SetCoefficients( coefs.data(), coefs.size() );
         }
 
         outputFile.WriteEvent( currentEvent );
+
+        upPrefetcher->Recycle( std::move(upCurrentEvent) );
     }
 
     outputFile.Close(); // Close flushes events to disk
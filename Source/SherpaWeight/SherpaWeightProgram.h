@@ -11,6 +11,7 @@
 // forward declarations
 
 class SherpaWeight;
+class EventPrefetcher;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -34,10 +35,12 @@ public:
     int Run( const RunParameters & param );
 
 private:
+    void StartInputPrefetch( const RunParameters & param );
     void SaveCoefficients( const RunParameters & param );
     
 private:
-    std::unique_ptr<SherpaWeight> m_upSherpaWeight;
+    std::unique_ptr<SherpaWeight>       m_upSherpaWeight;
+    std::unique_ptr<EventPrefetcher>    m_upPrefetcher;     // reads the input for SaveCoefficients ahead
 
 private:
     SherpaWeightProgram(const SherpaWeightProgram &) = delete;
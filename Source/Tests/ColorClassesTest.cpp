@@ -0,0 +1,111 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//  ColorClassesTest.cpp
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "ColorClasses.h"
+
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <set>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// the exhaustive scan that BalancedColorCombinations replaces: all 3^ncolinds assignments in
+// base-3 code order (first index fastest), keeping those with balanced colours and anti-colours
+
+static std::vector<std::vector<int>> ScannedColorCombinations( size_t ncolinds )
+{
+    std::vector<std::vector<int>> combinations;
+
+    const size_t half = ncolinds / 2;
+
+    size_t nCodes = 1;
+    for (size_t i = 0; i < ncolinds; ++i)
+        nCodes *= 3;
+
+    for (size_t code = 0; code < nCodes; ++code)
+    {
+        std::vector<int> combination( ncolinds );
+        int              balance[4] = { 0, 0, 0, 0 };
+
+        size_t digits = code;
+        for (size_t m = 0; m < ncolinds; ++m, digits /= 3)
+        {
+            combination[m] = static_cast<int>(digits % 3) + 1;
+            balance[combination[m]] += (m < half) ? 1 : -1;
+        }
+
+        if (!balance[1] && !balance[2] && !balance[3])
+            combinations.push_back( combination );
+    }
+
+    return combinations;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static void TestCombinations()
+{
+    for (size_t ncolinds = 0; ncolinds <= 10; ncolinds += 2)
+        TEST_CHECK( BalancedColorCombinations( ncolinds ) == ScannedColorCombinations( ncolinds ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static void TestClasses()
+{
+    for (size_t ncolinds = 2; ncolinds <= 10; ncolinds += 2)
+    {
+        ColorClassesPtr classes = ColorClasses( ncolinds );
+
+        TEST_CHECK( classes && (classes == ColorClasses( ncolinds )) );     // shared
+        if (!classes)
+            continue;
+
+        TEST_CHECK( classes->combinations.size() == classes->multiplicities.size() );
+
+        // the classes partition the combinations
+
+        double nCombinations = 0;
+        for (double multiplicity : classes->multiplicities)
+        {
+            TEST_CHECK( (multiplicity == 1) || (multiplicity == 3) || (multiplicity == 6) );
+            nCombinations += multiplicity;
+        }
+        TEST_CHECK( nCombinations == BalancedColorCombinations( ncolinds ).size() );
+
+        // each representative is balanced, distinct and numbers its colours in order of first appearance
+
+        std::set<std::vector<int>>      representatives;
+        std::vector<std::vector<int>>   combinations = BalancedColorCombinations( ncolinds );
+
+        for (const std::vector<int> & combination : classes->combinations)
+        {
+            TEST_CHECK( std::binary_search( combinations.begin(), combinations.end(), combination,
+                        []( const std::vector<int> & a, const std::vector<int> & b )
+                        { return std::lexicographical_compare( a.rbegin(), a.rend(), b.rbegin(), b.rend() ); } ) );
+
+            int nextColor = 1;
+            for (int color : combination)
+            {
+                TEST_CHECK( color <= nextColor );
+                nextColor = std::max( nextColor, color + 1 );
+            }
+
+            TEST_CHECK( representatives.insert( combination ).second );
+        }
+    }
+
+    // two colour indices: r rbar, g gbar and b bbar form one class
+
+    ColorClassesPtr classes = ColorClasses( 2 );
+    TEST_CHECK( (classes->combinations.size() == 1) && (classes->combinations[0] == std::vector<int>( { 1, 1 } )) );
+    TEST_CHECK( classes->multiplicities[0] == 3 );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+int main()
+{
+    TestCombinations();
+    TestClasses();
+
+    return TestResult( "ColorClassesTest" );
+}
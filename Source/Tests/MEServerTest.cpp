@@ -0,0 +1,90 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//  MEServerTest.cpp
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "MEServer.h"
+
+#include "TestCheck.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static void TestReadRequest()
+{
+    int fds[2];
+    TEST_CHECK( socketpair( AF_UNIX, SOCK_STREAM, 0, fds ) == 0 );
+
+    MEServerWriteLine( fds[0], "EVAL\tevents.hepmc\tMASS[6]=173.2\t\tOUTPUT=2" );
+    MEServerWriteLine( fds[0], "QUIT" );
+    MEServerWriteLine( fds[0], "EVAL" );
+
+    MEServerRequest request;
+    MEServerReadRequest( fds[1], request );
+
+    TEST_CHECK( !request.bQuit );
+    TEST_CHECK( request.inputFile == "events.hepmc" );
+    TEST_CHECK( (request.sherpaArgs.size() == 2) && (request.sherpaArgs[0] == "MASS[6]=173.2") && (request.sherpaArgs[1] == "OUTPUT=2") );
+
+    MEServerReadRequest( fds[1], request );
+    TEST_CHECK( request.bQuit );
+
+    TEST_CHECK_THROWS( MEServerReadRequest( fds[1], request ) );    // no input file
+
+    close( fds[0] );
+    TEST_CHECK_THROWS( MEServerReadRequest( fds[1], request ) );    // closed before a request
+    close( fds[1] );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static void TestPassConnection()
+{
+    int controlFds[2];
+    int connectionFds[2];
+    TEST_CHECK( socketpair( AF_UNIX, SOCK_STREAM, 0, controlFds ) == 0 );
+    TEST_CHECK( pipe( connectionFds ) == 0 );
+
+    MEServerRequest request;
+    request.inputFile  = "/data/events.root";
+    request.sherpaArgs = { "MODEL=SM", std::string( 5000, 'x' ) };     // longer than one read
+
+    MEServerSendConnection( controlFds[0], connectionFds[1], request );
+    close( connectionFds[1] );     // the receiver has its own descriptor
+
+    int             fd = -1;
+    MEServerRequest received;
+    TEST_CHECK( MEServerReceiveConnection( controlFds[1], fd, received ) );
+
+    TEST_CHECK( fd >= 0 );
+    TEST_CHECK( (received.inputFile == request.inputFile) && (received.sherpaArgs == request.sherpaArgs) );
+
+    // the received descriptor is the connection
+
+    char c = 0;
+    TEST_CHECK( write( fd, "R", 1 ) == 1 );
+    TEST_CHECK( (read( connectionFds[0], &c, 1 ) == 1) && (c == 'R') );
+    close( fd );
+
+    TEST_CHECK( read( connectionFds[0], &c, 1 ) == 0 );   // no other copy of the write end is left open
+    close( connectionFds[0] );
+
+    // a request that cannot be encoded is not sent
+
+    request.sherpaArgs.push_back( "A=1\tB=2" );
+    TEST_CHECK_THROWS( MEServerSendConnection( controlFds[0], 0, request ) );
+
+    // closing the control socket ends the receiver
+
+    close( controlFds[0] );
+    TEST_CHECK( !MEServerReceiveConnection( controlFds[1], fd, received ) && (fd < 0) );
+    close( controlFds[1] );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+int main()
+{
+    TestReadRequest();
+    TestPassConnection();
+
+    return TestResult( "MEServerTest" );
+}
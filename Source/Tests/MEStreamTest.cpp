@@ -0,0 +1,192 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//  MEStreamTest.cpp
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "MEStream.h"
+
+#include "TestCheck.h"
+
+#include <limits>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static double TestME( int32_t id, size_t point )
+{
+    return 1e-3 * id + 0.5 * point;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static std::vector<char> ReadFile( const std::string & path )
+{
+    std::vector<char> data;
+
+    int fd = open( path.c_str(), O_RDONLY );
+    char    buffer[4096];
+    ssize_t nRead = 0;
+    while ((fd >= 0) && ((nRead = read( fd, buffer, sizeof(buffer) )) > 0))
+        data.insert( data.end(), buffer, buffer + nRead );
+    close( fd );
+
+    return data;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static void TestParseTarget()
+{
+    int fd = -1;
+    TEST_CHECK( MEStreamWriter::ParseTarget( "fd:7", fd ) && (fd == 7) );
+    TEST_CHECK( !MEStreamWriter::ParseTarget( "results.root", fd ) );
+    TEST_CHECK_THROWS( MEStreamWriter::ParseTarget( "fd:", fd ) );
+    TEST_CHECK_THROWS( MEStreamWriter::ParseTarget( "fd:3x", fd ) );
+    TEST_CHECK_THROWS( MEStreamWriter::ParseTarget( "fd:-1", fd ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static void TestRoundTrip()
+{
+    const size_t  nPoints = 3;
+    const int32_t nEvents = 10000;  // several buffers
+
+    std::string path = TestTempFile( "MEStreamTest" );
+    {
+        MEStreamWriter writer( open( path.c_str(), O_WRONLY | O_TRUNC ), nPoints );
+
+        double me[nPoints];
+        for (int32_t id = 0; id < nEvents; ++id)
+        {
+            for (size_t point = 0; point < nPoints; ++point)
+                me[point] = TestME( id, point );
+            writer.Write( id, me );
+        }
+        writer.Finish();
+    }
+
+    std::vector<char> data = ReadFile( path );
+    TEST_CHECK( data.size() == 8 + nEvents * (sizeof(int32_t) + nPoints * sizeof(double)) + 12 );
+
+    // parse in chunks that split the header and the records, as a pipe delivers them
+
+    MEStreamReader reader;
+    int32_t        nextId = 0;
+    size_t         chunk  = 1;
+
+    for (size_t offset = 0; offset < data.size(); )
+    {
+        size_t nBytes = std::min( chunk, data.size() - offset );
+        reader.Parse( data.data() + offset, nBytes, [&nextId]( int32_t id, const double * pME, size_t n )
+        {
+            TEST_CHECK( (id == nextId) && (n == nPoints) );
+            for (size_t point = 0; point < n; ++point)
+                TEST_CHECK( pME[point] == TestME( id, point ) );
+            ++nextId;
+        });
+
+        offset += nBytes;
+        chunk   = chunk % 97 + 13;
+    }
+
+    TEST_CHECK( reader.Complete() );
+    TEST_CHECK( reader.NPoints()  == nPoints );
+    TEST_CHECK( reader.NRecords() == static_cast<uint64_t>(nEvents) );
+    TEST_CHECK( nextId == nEvents );
+
+    unlink( path.c_str() );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static std::vector<char> PipeStream( bool bFinish )
+{
+    int fds[2];
+    TEST_CHECK( pipe( fds ) == 0 );
+
+    const double me[2] = { 1.0, 2.0 };
+    {
+        MEStreamWriter writer( fds[1], 2 );
+        writer.Write( 5, me );
+        writer.Write( 6, me );
+        if (bFinish)
+            writer.Finish();
+    }   // otherwise closed by the destructor, as on an error
+
+    std::vector<char> data( 1024 );
+    ssize_t nRead = read( fds[0], data.data(), data.size() );
+    close( fds[0] );
+
+    data.resize( (nRead > 0) ? static_cast<size_t>(nRead) : 0 );
+    return data;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static void TestIncompleteStream()
+{
+    const size_t recordSize = sizeof(int32_t) + 2 * sizeof(double);
+
+    auto countRecords = []( size_t & nRecords ) { return [&nRecords]( int32_t, const double *, size_t ) { ++nRecords; }; };
+
+    // a stream closed without its end record is incomplete, even at a record boundary
+
+    std::vector<char> data = PipeStream( false );
+    TEST_CHECK( data.size() == 8 + 2 * recordSize );
+
+    MEStreamReader reader;
+    size_t nRecords = 0;
+    reader.Parse( data.data(), data.size(), countRecords( nRecords ) );
+
+    TEST_CHECK( !reader.Complete() );
+    TEST_CHECK( nRecords == 2 );
+
+    // a finished stream cut inside its end record or a record is incomplete
+
+    data = PipeStream( true );
+    TEST_CHECK( data.size() == 8 + 2 * recordSize + 12 );
+
+    for (size_t cut : { size_t(1), size_t(12), size_t(13) })
+    {
+        MEStreamReader cutReader;
+        nRecords = 0;
+        cutReader.Parse( data.data(), data.size() - cut, countRecords( nRecords ) );
+
+        TEST_CHECK( !cutReader.Complete() );
+        TEST_CHECK( nRecords == ((cut > 12) ? 1u : 2u) );
+    }
+
+    MEStreamReader fullReader;
+    fullReader.Parse( data.data(), data.size(), []( int32_t, const double *, size_t ) {} );
+    TEST_CHECK( fullReader.Complete() );
+
+    // data after the end record, a wrong record count and the reserved id are errors
+
+    TEST_CHECK_THROWS( fullReader.Parse( data.data(), 1, []( int32_t, const double *, size_t ) {} ) );
+
+    std::vector<char> badCount = data;
+    badCount[badCount.size() - 8] = 3;
+
+    MEStreamReader countReader;
+    TEST_CHECK_THROWS( countReader.Parse( badCount.data(), badCount.size(), []( int32_t, const double *, size_t ) {} ) );
+
+    {
+        MEStreamWriter writer( open( "/dev/null", O_WRONLY ), 2 );
+        const double me[2] = { 1.0, 2.0 };
+        TEST_CHECK_THROWS( writer.Write( std::numeric_limits<int32_t>::min(), me ) );
+    }
+
+    // an empty stream is incomplete, and a foreign header is an error
+
+    MEStreamReader emptyReader;
+    TEST_CHECK( !emptyReader.Complete() );
+
+    MEStreamReader badReader;
+    TEST_CHECK_THROWS( badReader.Parse( "XXXX\1\0\0\0", 8, []( int32_t, const double *, size_t ) {} ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+int main()
+{
+    TestParseTarget();
+    TestRoundTrip();
+    TestIncompleteStream();
+
+    return TestResult( "MEStreamTest" );
+}
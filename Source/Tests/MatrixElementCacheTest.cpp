@@ -0,0 +1,150 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//  MatrixElementCacheTest.cpp
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "MatrixElementCache.h"
+
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <list>
+#include <random>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static EventFileVertex TestVertex( size_t event )
+{
+    EventFileVertex vertex;
+
+    vertex.input .resize( 2 );
+    vertex.output.resize( 2 );
+
+    int32_t pdg = 1;
+    for (std::vector<EventFileVertex::Particle> * pParticles : { &vertex.input, &vertex.output })
+    {
+        for (EventFileVertex::Particle & part : *pParticles)
+        {
+            part.pdg = pdg++;
+            part.E   = 100.0 + event;
+            part.px  = 0.5 * pdg;
+            part.py  = -1.0 * event;
+            part.pz  = 2.0;
+        }
+    }
+
+    return vertex;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static void TestLeastRecentlyUsed()
+{
+    MatrixElementCache cache;
+    cache.Reset( 3 );
+    TEST_CHECK( cache.Capacity() == 3 );
+
+    for (size_t event = 0; event < 3; ++event)
+        cache.Add( HashVertex( TestVertex( event ) ), TestVertex( event ), 1.0 * event );
+
+    double me = -1;
+    TEST_CHECK( cache.Find( HashVertex( TestVertex( 0 ) ), TestVertex( 0 ), me ) && (me == 0) );    // 0 is now most recent
+
+    cache.Add( HashVertex( TestVertex( 3 ) ), TestVertex( 3 ), 3.0 );                               // evicts 1
+
+    TEST_CHECK( !cache.Find( HashVertex( TestVertex( 1 ) ), TestVertex( 1 ), me ) );
+    TEST_CHECK( cache.Find( HashVertex( TestVertex( 0 ) ), TestVertex( 0 ), me ) && (me == 0) );
+    TEST_CHECK( cache.Find( HashVertex( TestVertex( 2 ) ), TestVertex( 2 ), me ) && (me == 2) );
+    TEST_CHECK( cache.Find( HashVertex( TestVertex( 3 ) ), TestVertex( 3 ), me ) && (me == 3) );
+
+    // adding a cached event updates it
+
+    cache.Add( HashVertex( TestVertex( 2 ) ), TestVertex( 2 ), 20.0 );
+    TEST_CHECK( cache.Find( HashVertex( TestVertex( 2 ) ), TestVertex( 2 ), me ) && (me == 20) );
+
+    // reset removes all entries, and a cache without capacity stores nothing
+
+    cache.Reset( 3 );
+    TEST_CHECK( !cache.Find( HashVertex( TestVertex( 2 ) ), TestVertex( 2 ), me ) );
+
+    cache.Reset( 0 );
+    cache.Add( HashVertex( TestVertex( 2 ) ), TestVertex( 2 ), 2.0 );
+    TEST_CHECK( !cache.Find( HashVertex( TestVertex( 2 ) ), TestVertex( 2 ), me ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static void TestHashCollisions()
+{
+    // events with the same hash are told apart by their vertices, and share one probe sequence
+
+    MatrixElementCache cache;
+    cache.Reset( 4 );
+
+    for (size_t event = 0; event < 6; ++event)
+        cache.Add( 42, TestVertex( event ), 1.0 * event );      // evicts 0 and 1
+
+    double me = -1;
+    for (size_t event = 0; event < 6; ++event)
+    {
+        bool bFound = cache.Find( 42, TestVertex( event ), me );
+        TEST_CHECK( bFound == (event >= 2) );
+        TEST_CHECK( !bFound || (me == event) );
+    }
+
+    TEST_CHECK( !cache.Find( 43, TestVertex( 5 ), me ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// random finds and adds compared with a list kept in order of use; few distinct hashes make long
+// probe sequences, so evictions shift entries back into their holes
+
+static void TestAgainstList()
+{
+    const size_t capacity = 16;
+
+    MatrixElementCache cache;
+    cache.Reset( capacity );
+
+    std::list<std::pair<size_t, double>> reference;     // (event, me), most recently used first
+
+    std::mt19937 random( 12345 );
+    for (size_t step = 0; step < 100000; ++step)
+    {
+        size_t   event = random() % 64;
+        uint64_t hash  = event % 8;
+
+        auto itrRef = std::find_if( reference.begin(), reference.end(),
+                                    [event]( const std::pair<size_t, double> & entry ) { return entry.first == event; } );
+
+        double me     = -1;
+        bool   bFound = cache.Find( hash, TestVertex( event ), me );
+
+        TEST_CHECK( bFound == (itrRef != reference.end()) );
+        if (itrRef != reference.end())
+        {
+            TEST_CHECK( me == itrRef->second );
+            reference.splice( reference.begin(), reference, itrRef );
+        }
+
+        if (!bFound || (random() % 4 == 0))
+        {
+            me = static_cast<double>(step);
+            cache.Add( hash, TestVertex( event ), me );
+
+            if (bFound)
+                reference.front().second = me;
+            else
+                reference.push_front( std::make_pair( event, me ) );
+
+            if (reference.size() > capacity)
+                reference.pop_back();
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+int main()
+{
+    TestLeastRecentlyUsed();
+    TestHashCollisions();
+    TestAgainstList();
+
+    return TestResult( "MatrixElementCacheTest" );
+}
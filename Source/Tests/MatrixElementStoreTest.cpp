@@ -0,0 +1,179 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//  MatrixElementStoreTest.cpp
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "MatrixElementStore.h"
+
+#include "TestCheck.h"
+
+#include <algorithm>
+
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static const size_t HeaderSize = 8;     // magic and record size
+static const size_t RecordSize = 24;    // event hash, check hash and matrix element
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static std::vector<std::string> StoreFiles( const std::string & directory )
+{
+    std::vector<std::string> files;
+
+    if (DIR * pDir = opendir( directory.c_str() ))
+    {
+        while (struct dirent * pEntry = readdir( pDir ))
+        {
+            if (pEntry->d_name[0] != '.')
+                files.push_back( directory + "/" + pEntry->d_name );
+        }
+        closedir( pDir );
+    }
+
+    std::sort( files.begin(), files.end() );
+    return files;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static off_t FileSize( const std::string & filePath )
+{
+    struct stat info;
+    return (stat( filePath.c_str(), &info ) == 0) ? info.st_size : -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static void AppendBytes( const std::string & filePath, const void * pData, size_t nBytes )
+{
+    int fd = open( filePath.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0666 );
+    TEST_CHECK( (fd >= 0) && (write( fd, pData, nBytes ) == static_cast<ssize_t>(nBytes)) );
+    close( fd );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static void RemoveDirectory( const std::string & directory )
+{
+    for (const std::string & file : StoreFiles( directory ))
+        unlink( file.c_str() );
+    rmdir( directory.c_str() );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static void TestRoundTrip( const std::string & directory )
+{
+    {
+        MatrixElementStore store( directory );
+        store.SelectPoint( "point1" );
+
+        for (uint64_t i = 0; i < 10000; ++i)    // more than one automatic flush
+            store.Add( i, ~i, 0.5 * i );
+
+        double me = 0;
+        TEST_CHECK( store.Find( 7, ~uint64_t(7), me ) && (me == 3.5) );
+        TEST_CHECK( store.NAdded() == 10000 );
+    }   // flushed by the destructor
+
+    std::vector<std::string> files = StoreFiles( directory );
+    TEST_CHECK( files.size() == 1 );
+    TEST_CHECK( !files.empty() && (FileSize( files[0] ) == static_cast<off_t>(HeaderSize + 10000 * RecordSize)) );
+
+    MatrixElementStore store( directory );
+    store.SelectPoint( "point1" );
+
+    double me = 0;
+    TEST_CHECK( store.Find( 9999, ~uint64_t(9999), me ) && (me == 0.5 * 9999) );
+    TEST_CHECK( store.NFound() == 1 );
+
+    // a matching event hash with a different check hash is a collision, not a match
+    TEST_CHECK( !store.Find( 9999, 9999, me ) );
+    TEST_CHECK( store.NCollisions() == 1 );
+
+    // points are kept apart
+    store.SelectPoint( "point2" );
+    TEST_CHECK( !store.Find( 7, ~uint64_t(7), me ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static void TestPartialRecords( const std::string & directory )
+{
+    // the file of another (interrupted) process: its whole records are merged, the partial one ignored
+
+    std::vector<std::string> files = StoreFiles( directory );
+    TEST_CHECK( files.size() == 1 );
+    if (files.size() != 1)
+        return;
+
+    std::string otherFile = directory + "/ME_point1.otherhost.1.dat";
+    {
+        std::vector<char> data( HeaderSize + 2 * RecordSize );
+
+        int fd = open( files[0].c_str(), O_RDONLY );
+        TEST_CHECK( read( fd, data.data(), data.size() ) == static_cast<ssize_t>(data.size()) );
+        close( fd );
+
+        const uint64_t hashes[2] = { 20000, ~uint64_t(20000) };
+        const double   me        = 42;
+        memcpy( data.data() + HeaderSize + RecordSize,                      hashes, sizeof(hashes) );
+        memcpy( data.data() + HeaderSize + RecordSize + sizeof(hashes),     &me,    sizeof(me) );
+
+        AppendBytes( otherFile, data.data(), data.size() - 3 );     // the second record is cut short
+    }
+
+    // a file with a foreign header is skipped
+    AppendBytes( directory + "/ME_point1.otherhost.2.dat", "XXXX\x10\0\0\0", HeaderSize );
+
+    {
+        MatrixElementStore store( directory );
+        store.SelectPoint( "point1" );
+
+        double me = 0;
+        TEST_CHECK( store.Find( 0, ~uint64_t(0), me ) && (me == 0) );
+        TEST_CHECK( !store.Find( 20000, ~uint64_t(20000), me ) );
+    }
+
+    // this process's own file with a trailing partial record is truncated to its whole records
+    // before new records are appended
+
+    std::string ownFile = files[0];
+    AppendBytes( ownFile, "partial", 7 );
+
+    {
+        MatrixElementStore store( directory );
+        store.SelectPoint( "point1" );
+
+        double me = 0;
+        TEST_CHECK( store.Find( 1, ~uint64_t(1), me ) && (me == 0.5) );
+
+        store.Add( 30000, 1, 2.0 );
+        store.Flush();
+    }
+
+    TEST_CHECK( FileSize( ownFile ) == static_cast<off_t>(HeaderSize + 10001 * RecordSize) );
+
+    MatrixElementStore store( directory );
+    store.SelectPoint( "point1" );
+
+    double me = 0;
+    TEST_CHECK( store.Find( 30000, 1, me ) && (me == 2.0) );
+    TEST_CHECK( store.Find( 9999, ~uint64_t(9999), me ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+int main()
+{
+    char directory[] = "/tmp/MatrixElementStoreTest_XXXXXX";
+    if (!mkdtemp( directory ))
+    {
+        LogMsgError( "Failed to create temporary directory." );
+        return EXIT_FAILURE;
+    }
+
+    TestRoundTrip( directory );
+    TestPartialRecords( directory );
+
+    RemoveDirectory( directory );
+
+    return TestResult( "MatrixElementStoreTest" );
+}
@@ -0,0 +1,81 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//  SherpaArgsTest.cpp
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "SherpaArgs.h"
+
+#include "TestCheck.h"
+
+#include <fstream>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static void WriteFile( const std::string & path, const std::string & contents )
+{
+    std::ofstream file( path, std::ios::trunc );
+    file << contents;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static void TestRunFileArgs()
+{
+    const std::vector<std::string> args = { "MODEL=SM", "MASS[6]=173.2" };
+
+    uint64_t hash = PointArgsHash( args );
+
+    // arguments that only name run files do not change the point
+
+    std::vector<std::string> runArgs = args;
+    runArgs.push_back( "RESULT_DIRECTORY=/tmp/run1/Results" );
+    runArgs.push_back( "OUTPUT=2" );
+    runArgs.push_back( "LOG_FILE=run1.log" );
+    TEST_CHECK( PointArgsHash( runArgs ) == hash );
+
+    // parameter values and their order do
+
+    TEST_CHECK( PointArgsHash( { "MODEL=SM", "MASS[6]=172.5" } ) != hash );
+    TEST_CHECK( PointArgsHash( { "MASS[6]=173.2", "MODEL=SM" } ) != hash );
+    TEST_CHECK( PointArgsHash( { "MODEL=SMMASS[6]=173.2" } )    != hash );    // arguments are separated
+    TEST_CHECK( PointArgsHash( {} ) == HashSeed );
+
+    // a seed continues a hash
+
+    TEST_CHECK( PointArgsHash( args, 12345 ) != hash );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static void TestParameterCards()
+{
+    std::string card1 = TestTempFile( "SherpaArgsTest" );
+    std::string card2 = TestTempFile( "SherpaArgsTest" );
+
+    WriteFile( card1, "Block MASS\n  6 1.732000e+02\n" );
+    WriteFile( card2, "Block MASS\n  6 1.732000e+02\n" );
+
+    // cards are compared by their contents, not their paths
+
+    uint64_t hash = PointArgsHash( { "MODEL=UFO", "UFO_PARAM_CARD=" + card1 } );
+    TEST_CHECK( PointArgsHash( { "MODEL=UFO", "UFO_PARAM_CARD=" + card2 } ) == hash );
+    TEST_CHECK( PointArgsHash( { "MODEL=UFO", "FR_PARAMCARD="   + card2 } ) == hash );
+
+    WriteFile( card2, "Block MASS\n  6 1.725000e+02\n" );
+    TEST_CHECK( PointArgsHash( { "MODEL=UFO", "UFO_PARAM_CARD=" + card2 } ) != hash );
+
+    // a missing card hashes as an empty one
+
+    WriteFile( card2, "" );
+    uint64_t emptyHash = PointArgsHash( { "MODEL=UFO", "UFO_PARAM_CARD=" + card2 } );
+
+    unlink( card2.c_str() );
+    TEST_CHECK( PointArgsHash( { "MODEL=UFO", "UFO_PARAM_CARD=" + card2 } ) == emptyHash );
+
+    unlink( card1.c_str() );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+int main()
+{
+    TestRunFileArgs();
+    TestParameterCards();
+
+    return TestResult( "SherpaArgsTest" );
+}
@@ -0,0 +1,67 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//  TestCheck.h
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include "common.h"
+
+#include <unistd.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Checks for the unit tests of the Common modules (make test). Each test is a program of its own
+// that reports the failed checks and exits with EXIT_FAILURE if there were any.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int g_nFailedChecks = 0;
+
+#define TEST_CHECK( condition )                                                                     \
+    do                                                                                              \
+    {                                                                                               \
+        if (!(condition))                                                                           \
+        {                                                                                           \
+            ++g_nFailedChecks;                                                                      \
+            LogMsgError( "%hs:%i: check failed: %hs", FMT_HS(__FILE__), FMT_I(__LINE__), FMT_HS(#condition) ); \
+        }                                                                                           \
+    } while (false)
+
+#define TEST_CHECK_THROWS( statement )                                                              \
+    do                                                                                              \
+    {                                                                                               \
+        bool bThrown = false;                                                                       \
+        try { statement; } catch (const std::exception &) { bThrown = true; }                       \
+        TEST_CHECK( bThrown && #statement );                                                        \
+    } while (false)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+inline int TestResult( const char * testName )
+{
+    if (g_nFailedChecks)
+    {
+        LogMsgError( "%hs: %i checks failed.", FMT_HS(testName), FMT_I(g_nFailedChecks) );
+        return EXIT_FAILURE;
+    }
+
+    LogMsgInfo( "%hs: passed.", FMT_HS(testName) );
+    return EXIT_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// path of a new empty temporary file; the test removes it
+
+inline std::string TestTempFile( const char * prefix )
+{
+    std::string path = std::string( "/tmp/" ) + prefix + "_XXXXXX";
+
+    int fd = mkstemp( &path[0] );
+    if (fd < 0)
+        ThrowError( std::system_error( errno, std::generic_category(), "Failed to create temporary file." ) );
+
+    close( fd );
+    return path;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // TEST_CHECK_H
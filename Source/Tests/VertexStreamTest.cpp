@@ -0,0 +1,110 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//  VertexStreamTest.cpp
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "VertexStream.h"
+
+#include "TestCheck.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static EventFileVertex TestVertex( size_t event )
+{
+    EventFileVertex vertex;
+
+    vertex.input .resize( 2 );
+    vertex.output.resize( 2 + event % 3 );
+
+    int32_t pdg = 1;
+    for (std::vector<EventFileVertex::Particle> * pParticles : { &vertex.input, &vertex.output })
+    {
+        for (EventFileVertex::Particle & part : *pParticles)
+        {
+            part.pdg = pdg++ * ((event % 2) ? -1 : 1);
+            part.E   = 100.0 + event + 0.25 * pdg;
+            part.px  = 1.0 / (event + pdg);
+            part.py  = -2.5 * event;
+            part.pz  = 1e-3 * pdg;
+        }
+    }
+
+    return vertex;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static void TestRoundTrip()
+{
+    const size_t nEvents = 5000;    // several buffers
+
+    std::string path = TestTempFile( "VertexStreamTest" );
+
+    {
+        VertexStreamWriter writer( open( path.c_str(), O_WRONLY | O_TRUNC ) );
+        for (size_t event = 0; event < nEvents; ++event)
+            writer.Write( 3 * event, static_cast<int32_t>(event) + 7, TestVertex( event ) );
+        writer.Close();
+
+        TEST_CHECK( writer.NRecords() == nEvents );
+    }
+
+    VertexStreamReader reader( open( path.c_str(), O_RDONLY ) );
+
+    for (int pass = 0; pass < 2; ++pass)    // read, rewind and read again
+    {
+        uint64_t        entry   = 0;
+        int32_t         eventId = 0;
+        EventFileVertex vertex;
+
+        size_t event = 0;
+        for ( ; reader.Read( entry, eventId, vertex ); ++event)
+        {
+            TEST_CHECK( entry   == 3 * event );
+            TEST_CHECK( eventId == static_cast<int32_t>(event) + 7 );
+            TEST_CHECK( SameKinematics( vertex, TestVertex( event ) ) );
+        }
+
+        TEST_CHECK( event == nEvents );
+        TEST_CHECK( reader.NRecords() == nEvents );
+
+        reader.Rewind();
+    }
+
+    unlink( path.c_str() );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static void TestPartialRecord()
+{
+    std::vector<char> buffer;
+    VertexStreamWriter::Encode( buffer, 1, 2, TestVertex( 0 ) );
+    VertexStreamWriter::Encode( buffer, 2, 3, TestVertex( 1 ) );
+
+    std::string path = TestTempFile( "VertexStreamTest" );
+    {
+        int fd = open( path.c_str(), O_WRONLY | O_TRUNC );
+        TEST_CHECK( write( fd, buffer.data(), buffer.size() - 5 ) == static_cast<ssize_t>(buffer.size() - 5) );
+        close( fd );
+    }
+
+    VertexStreamReader reader( open( path.c_str(), O_RDONLY ) );
+
+    uint64_t        entry   = 0;
+    int32_t         eventId = 0;
+    EventFileVertex vertex;
+
+    TEST_CHECK( reader.Read( entry, eventId, vertex ) && (eventId == 2) );
+    TEST_CHECK_THROWS( reader.Read( entry, eventId, vertex ) );
+
+    unlink( path.c_str() );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+int main()
+{
+    TestRoundTrip();
+    TestPartialRecord();
+
+    return TestResult( "VertexStreamTest" );
+}